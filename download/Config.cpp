@@ -10,6 +10,7 @@
 #include <macgyver/Exception.h>
 #include <spine/ConfigTools.h>
 #include <spine/Exceptions.h>
+#include <zstd.h>
 #include <stdexcept>
 
 using namespace std;
@@ -126,6 +127,10 @@ void Config::parseConfigProducer(const string& name, Producer& currentSettings)
           {
             currentSettings.multiFile = settings[i];
           }
+          else if (paramName == "compression")
+          {
+            parseCompressionLevels(settings[i], currentSettings.compressionLevels);
+          }
           else
           {
             throw Fmi::Exception(BCP,
@@ -152,10 +157,12 @@ void Config::parseConfigProducer(const string& name, Producer& currentSettings)
     prod.verticalInterpolation = currentSettings.verticalInterpolation;
     prod.datumShift = currentSettings.datumShift;
     prod.multiFile = currentSettings.multiFile;
+    prod.compressionLevels = currentSettings.compressionLevels;
 
     currentSettings.namedSettings.clear();
     currentSettings.gridDefaultLevels.clear();
     currentSettings.multiFile = false;
+    currentSettings.compressionLevels.clear();
 
     itsProducers.insert(Producers::value_type(name, prod));
   }
@@ -165,6 +172,96 @@ void Config::parseConfigProducer(const string& name, Producer& currentSettings)
   }
 }
 
+// ----------------------------------------------------------------------
+/*!
+ * \brief Parse compression levels of output formats.
+ *
+ *		The levels are given by format (netcdf or qd) and content encoding
+ *		(gzip or zstd), e.g. netcdf: { gzip = 6; zstd = 3; }; level 0
+ *		disables the encoding
+ */
+// ----------------------------------------------------------------------
+
+void Config::parseCompressionLevels(const libconfig::Setting& settings,
+                                    std::map<std::string, int>& levels) const
+{
+  try
+  {
+    if (!settings.isGroup())
+      throw Fmi::Exception(BCP,
+                           "compression settings must be a group in dls configuration file line " +
+                               boost::lexical_cast<string>(settings.getSourceLine()));
+
+    for (int i = 0; i < settings.getLength(); ++i)
+    {
+      string format = settings[i].getName();
+
+      if ((format == "zstdthreads") || (format == "zstdthreadedsize"))
+        continue;
+
+      if ((format != "netcdf") && (format != "qd"))
+        throw Fmi::Exception(BCP,
+                             "Unrecognized compression format '" + format +
+                                 "' in dls configuration on line " +
+                                 boost::lexical_cast<string>(settings[i].getSourceLine()));
+
+      const libconfig::Setting& encodings = settings[i];
+
+      if (!encodings.isGroup())
+        throw Fmi::Exception(BCP,
+                             "compression." + format +
+                                 " must be a group in dls configuration file line " +
+                                 boost::lexical_cast<string>(encodings.getSourceLine()));
+
+      for (int j = 0; j < encodings.getLength(); ++j)
+      {
+        string encoding = encodings[j].getName();
+        int level = encodings[j];
+        int maxLevel = ((encoding == "gzip") ? 9 : ZSTD_maxCLevel());
+
+        if ((encoding != "gzip") && (encoding != "zstd"))
+          throw Fmi::Exception(BCP,
+                               "Unrecognized content encoding '" + encoding +
+                                   "' in dls configuration on line " +
+                                   boost::lexical_cast<string>(encodings[j].getSourceLine()));
+
+        if ((level < 0) || (level > maxLevel))
+          throw Fmi::Exception(BCP,
+                               "compression." + format + "." + encoding + " must be 0-" +
+                                   boost::lexical_cast<string>(maxLevel) +
+                                   " in dls configuration on line " +
+                                   boost::lexical_cast<string>(encodings[j].getSourceLine()));
+
+        levels[format + "." + encoding] = level;
+      }
+    }
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Get compression level for given format and content encoding.
+ *
+ *		Producer's setting overrides the global setting; 0 if disabled
+ */
+// ----------------------------------------------------------------------
+
+int Config::getCompressionLevel(const Producer& producer, const std::string& key) const
+{
+  auto it = producer.compressionLevels.find(key);
+
+  if (it != producer.compressionLevels.end())
+    return it->second;
+
+  it = itsCompressionLevels.find(key);
+
+  return ((it != itsCompressionLevels.end()) ? it->second : 0);
+}
+
 // ----------------------------------------------------------------------
 /*!
  * \brief Parse and push environment settings
@@ -472,6 +569,131 @@ Config::Config(const string& configfile)
     if (itsConfig.exists("logrequestdatavalues"))
       itsLogRequestDataValues = itsConfig.lookup("logrequestdatavalues");
 
+    // Admission control; max total estimated cpu cost of concurrently processed requests,
+    // cost reserved for requests whose cost can not be estimated before loading data, max
+    // number of requests waiting for the budget to allow them and max time in seconds they
+    // wait, and the time in seconds the client is advised to retry a rejected request after
+
+    if (itsConfig.exists("admission.maxconcurrentcost"))
+      itsMaxConcurrentCost = itsConfig.lookup("admission.maxconcurrentcost");
+
+    if (itsConfig.exists("admission.defaultcost"))
+      itsAdmissionDefaultCost = itsConfig.lookup("admission.defaultcost");
+
+    if (itsConfig.exists("admission.maxqueued"))
+      itsAdmissionMaxQueued = itsConfig.lookup("admission.maxqueued");
+
+    if (itsConfig.exists("admission.queuetimeout"))
+      itsAdmissionQueueTimeout = itsConfig.lookup("admission.queuetimeout");
+
+    if (itsConfig.exists("admission.retryafter"))
+      itsAdmissionRetryAfter = itsConfig.lookup("admission.retryafter");
+
+    // Max estimated cpu cost of queries classified as fast
+
+    if (itsConfig.exists("fastquery.maxcost"))
+      itsMaxFastQueryCost = itsConfig.lookup("fastquery.maxcost");
+
+    // Max time in milliseconds spent generating data for a single returned chunk
+
+    if (itsConfig.exists("chunktimebudget"))
+      itsChunkTimeBudget = itsConfig.lookup("chunktimebudget");
+
+    // Max time in seconds for extracting the data of a request (time spent waiting for the
+    // client to read the output is not counted); data extraction is cancelled when exceeded
+
+    if (itsConfig.exists("maxrequesttime"))
+      itsMaxRequestTime = itsConfig.lookup("maxrequesttime");
+
+    // Number of worker threads (shared by all requests) extracting querydata grids in parallel
+    // for netcdf output
+
+    if (itsConfig.exists("netcdf.extractionthreads"))
+      itsNetCdfExtractionThreads = itsConfig.lookup("netcdf.extractionthreads");
+
+    // Sharing the output of identical concurrent requests; max buffered output size and max
+    // time to wait for the stream's creator to set up the data source
+
+    if (itsConfig.exists("sharedstreams.maxbuffersize"))
+      itsSharedStreamBufferSize = itsConfig.lookup("sharedstreams.maxbuffersize");
+
+    if (itsConfig.exists("sharedstreams.sourcetimeout"))
+      itsSharedStreamSourceTimeout = itsConfig.lookup("sharedstreams.sourcetimeout");
+
+    // Pregenerated products; request options, cache directory and interval in seconds to check
+    // for new data
+
+    if (itsConfig.exists("hotproducts.products"))
+    {
+      libconfig::Setting& products = itsConfig.lookup("hotproducts.products");
+      if (!products.isArray())
+        throw Fmi::Exception(BCP, "hotproducts.products must be an array");
+
+      for (auto i = 0; i < products.getLength(); ++i)
+        itsHotProducts.push_back(products[i]);
+
+      itsHotProductDirectory = itsTempDirectory + "/hotproducts";
+      itsConfig.lookupValue("hotproducts.directory", itsHotProductDirectory);
+
+      if (itsConfig.exists("hotproducts.checkinterval"))
+        itsHotProductCheckInterval = itsConfig.lookup("hotproducts.checkinterval");
+
+      if (itsHotProductCheckInterval == 0)
+        throw Fmi::Exception(BCP, "hotproducts.checkinterval must be positive");
+    }
+
+    // Disk cache of outputs shared by server processes; cache directory, max total size of
+    // the cached outputs and max size of a cached output in bytes
+
+    itsConfig.lookupValue("outputcache.directory", itsOutputCacheDirectory);
+
+    if (itsConfig.exists("outputcache.maxsize"))
+      itsOutputCacheMaxSize = itsConfig.lookup("outputcache.maxsize");
+
+    if (itsConfig.exists("outputcache.maxentrysize"))
+      itsOutputCacheMaxEntrySize = itsConfig.lookup("outputcache.maxentrysize");
+
+    // Memory cache of computed output grid coordinates; max total size of the cached
+    // coordinates in bytes
+
+    if (itsConfig.exists("coordinatecache.maxsize"))
+      itsCoordinateCacheMaxSize = itsConfig.lookup("coordinatecache.maxsize");
+
+    // Byte ranges; max number of outputs whose generated grib message sizes are indexed
+
+    if (itsConfig.exists("ranges.messageindexsize"))
+      itsMessageIndexSize = itsConfig.lookup("ranges.messageindexsize");
+
+    // Waiting for new origintime (/download/origintime); interval in seconds to check for new
+    // data, max wait time in seconds and max number of concurrently waiting requests
+
+    if (itsConfig.exists("origintimewait.checkinterval"))
+      itsOriginTimeWaitCheckInterval = itsConfig.lookup("origintimewait.checkinterval");
+
+    if (itsOriginTimeWaitCheckInterval == 0)
+      throw Fmi::Exception(BCP, "origintimewait.checkinterval must be positive");
+
+    if (itsConfig.exists("origintimewait.maxtimeout"))
+      itsOriginTimeWaitMaxTimeout = itsConfig.lookup("origintimewait.maxtimeout");
+
+    if (itsConfig.exists("origintimewait.maxwaiters"))
+      itsOriginTimeWaitMaxWaiters = itsConfig.lookup("origintimewait.maxwaiters");
+
+    // Content encoding (gzip/zstd compression) of netcdf and querydata output; compression
+    // levels by format and encoding, number of zstd worker threads and min (estimated) output
+    // size in bytes for using them
+
+    if (itsConfig.exists("compression"))
+    {
+      parseCompressionLevels(itsConfig.lookup("compression"), itsCompressionLevels);
+
+      if (itsConfig.exists("compression.zstdthreads"))
+        itsZstdThreads = itsConfig.lookup("compression.zstdthreads");
+
+      if (itsConfig.exists("compression.zstdthreadedsize"))
+        itsZstdThreadedSize = itsConfig.lookup("compression.zstdthreadedsize");
+    }
+
     // Legacy or WGS84 mode as set by newbase.
     //
     // For testing purposes, use LegacyMode setting if given
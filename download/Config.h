@@ -11,7 +11,9 @@
 #include <boost/utility.hpp>
 #include <spine/Reactor.h>
 #include <libconfig.h++>
+#include <map>
 #include <string>
+#include <vector>
 
 namespace SmartMet
 {
@@ -63,6 +65,40 @@ class Config
   unsigned long getMaxRequestDataValues() const { return itsMaxRequestDataValues; }
   unsigned long getLogRequestDataValues() const { return itsLogRequestDataValues; }
 
+  unsigned long getMaxConcurrentCost() const { return itsMaxConcurrentCost; }
+  unsigned long getAdmissionDefaultCost() const { return itsAdmissionDefaultCost; }
+  unsigned int getAdmissionMaxQueued() const { return itsAdmissionMaxQueued; }
+  unsigned int getAdmissionQueueTimeout() const { return itsAdmissionQueueTimeout; }
+  unsigned int getAdmissionRetryAfter() const { return itsAdmissionRetryAfter; }
+  unsigned long getMaxFastQueryCost() const { return itsMaxFastQueryCost; }
+  unsigned int getChunkTimeBudget() const { return itsChunkTimeBudget; }
+  unsigned int getMaxRequestTime() const { return itsMaxRequestTime; }
+  unsigned int getNetCdfExtractionThreads() const { return itsNetCdfExtractionThreads; }
+  unsigned long getSharedStreamBufferSize() const { return itsSharedStreamBufferSize; }
+  unsigned int getSharedStreamSourceTimeout() const { return itsSharedStreamSourceTimeout; }
+
+  const std::vector<std::string>& getHotProducts() const { return itsHotProducts; }
+  const std::string& getHotProductDirectory() const { return itsHotProductDirectory; }
+  unsigned int getHotProductCheckInterval() const { return itsHotProductCheckInterval; }
+
+  const std::string& getOutputCacheDirectory() const { return itsOutputCacheDirectory; }
+  unsigned long getOutputCacheMaxSize() const { return itsOutputCacheMaxSize; }
+  unsigned long getOutputCacheMaxEntrySize() const { return itsOutputCacheMaxEntrySize; }
+
+  unsigned long getCoordinateCacheMaxSize() const { return itsCoordinateCacheMaxSize; }
+
+  unsigned int getMessageIndexSize() const { return itsMessageIndexSize; }
+
+  unsigned int getOriginTimeWaitCheckInterval() const { return itsOriginTimeWaitCheckInterval; }
+  unsigned int getOriginTimeWaitMaxTimeout() const { return itsOriginTimeWaitMaxTimeout; }
+  unsigned int getOriginTimeWaitMaxWaiters() const { return itsOriginTimeWaitMaxWaiters; }
+
+  // Compression level for given format and content encoding (e.g. "netcdf.gzip"); 0 if disabled
+
+  int getCompressionLevel(const Producer& producer, const std::string& key) const;
+  unsigned int getZstdThreads() const { return itsZstdThreads; }
+  unsigned long getZstdThreadedSize() const { return itsZstdThreadedSize; }
+
   bool getLegacyMode() const { return itsLegacyMode; }
 
  private:
@@ -85,9 +121,45 @@ class Config
   unsigned long itsMaxRequestDataValues = 1024 * 1024 * 1024;
   unsigned long itsLogRequestDataValues = 0;  // if 0, no logging
 
+  unsigned long itsMaxConcurrentCost = 0;      // if 0, no admission control
+  unsigned long itsAdmissionDefaultCost = 0;   // if 0, 10% of max concurrent cost
+  unsigned int itsAdmissionMaxQueued = 10;     // max number of queued requests
+  unsigned int itsAdmissionQueueTimeout = 10;  // seconds; if 0, requests are not queued
+  unsigned int itsAdmissionRetryAfter = 30;    // seconds to retry rejected request after
+  unsigned long itsMaxFastQueryCost = 0;       // if 0, all queries are slow
+  unsigned int itsChunkTimeBudget = 0;         // milliseconds; if 0, no limit
+  unsigned int itsMaxRequestTime = 0;          // seconds; if 0, no limit
+
+  unsigned int itsNetCdfExtractionThreads = 0;  // if 0 or 1, grids are extracted sequentially
+
+  unsigned long itsSharedStreamBufferSize = 0;     // if 0, identical requests are not shared
+  unsigned int itsSharedStreamSourceTimeout = 10;  // max seconds to wait for the source streamer
+
+  std::vector<std::string> itsHotProducts;  // Request options of pregenerated products
+  std::string itsHotProductDirectory;
+  unsigned int itsHotProductCheckInterval = 60;  // seconds
+
+  std::string itsOutputCacheDirectory;  // if empty, outputs are not cached
+  unsigned long itsOutputCacheMaxSize = 1024UL * 1024 * 1024;       // bytes; if 0, no limit
+  unsigned long itsOutputCacheMaxEntrySize = 256UL * 1024 * 1024;  // bytes; if 0, no limit
+
+  unsigned long itsCoordinateCacheMaxSize = 256UL * 1024 * 1024;  // bytes; if 0, no caching
+
+  unsigned int itsMessageIndexSize = 1000;  // outputs; if 0, no indexing
+
+  unsigned int itsOriginTimeWaitCheckInterval = 10;  // seconds
+  unsigned int itsOriginTimeWaitMaxTimeout = 300;    // seconds
+  unsigned int itsOriginTimeWaitMaxWaiters = 20;     // Max number of waiting requests
+
+  std::map<std::string, int> itsCompressionLevels;         // by "format.encoding"
+  unsigned int itsZstdThreads = 0;                         // if 0, no worker threads
+  unsigned long itsZstdThreadedSize = 64UL * 1024 * 1024;  // bytes
+
   void parseConfigProducers(
       const Engine::Querydata::Engine& querydata, const Engine::Grid::Engine* griddata);
   void parseConfigProducer(const std::string& name, Producer& currentSettings);
+  void parseCompressionLevels(const libconfig::Setting& settings,
+                              std::map<std::string, int>& levels) const;
 
   void setEnvSettings();
 
@@ -0,0 +1,416 @@
+// ======================================================================
+/*!
+ * \brief SmartMet download service plugin; HTTP content encoding
+ *        (streaming gzip/zstd compression of the output)
+ */
+// ======================================================================
+
+#include "ContentEncoding.h"
+#include <boost/algorithm/string/classification.hpp>
+#include <boost/algorithm/string/split.hpp>
+#include <boost/algorithm/string/trim.hpp>
+#include <macgyver/Exception.h>
+#include <macgyver/StringConversion.h>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+namespace
+{
+const std::size_t gzipOutputBufferSize = 256 * 1024;
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Get the quality value of given content coding in Accept-Encoding
+ *        header; 0 if the coding is not acceptable
+ */
+// ----------------------------------------------------------------------
+
+double acceptedQuality(const std::string &acceptEncoding, const std::string &coding)
+{
+  std::vector<std::string> items;
+  boost::algorithm::split(items, acceptEncoding, boost::algorithm::is_any_of(","));
+
+  std::optional<double> quality, wildcardQuality;
+
+  for (auto const &item : items)
+  {
+    std::vector<std::string> parts;
+    boost::algorithm::split(parts, item, boost::algorithm::is_any_of(";"));
+
+    auto name = boost::algorithm::trim_copy(parts[0]);
+    Fmi::ascii_tolower(name);
+
+    if ((name != coding) && (name != "*"))
+      continue;
+
+    double q = 1;
+
+    for (std::size_t i = 1; (i < parts.size()); i++)
+    {
+      auto param = boost::algorithm::trim_copy(parts[i]);
+
+      if ((param.size() > 2) && ((param[0] == 'q') || (param[0] == 'Q')) && (param[1] == '='))
+        q = strtod(param.c_str() + 2, nullptr);
+    }
+
+    if (name == coding)
+      quality = q;
+    else
+      wildcardQuality = q;
+  }
+
+  // Explicitly given coding overrides the wildcard
+
+  if (quality)
+    return *quality;
+
+  return (wildcardQuality ? *wildcardQuality : 0);
+}
+
+}  // namespace
+
+using namespace std;
+
+namespace SmartMet
+{
+namespace Plugin
+{
+namespace Download
+{
+// ----------------------------------------------------------------------
+/*!
+ * \brief Get Content-Encoding header value
+ */
+// ----------------------------------------------------------------------
+
+std::string Compression::name() const
+{
+  switch (encoding)
+  {
+    case ContentEncoding::Gzip:
+      return "gzip";
+    case ContentEncoding::Zstd:
+      return "zstd";
+    default:
+      return "identity";
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Select content encoding.
+ *
+ *		The encodings having a compression level configured for the output
+ *		format and producer are available. The encoding with highest
+ *		quality value in Accept-Encoding header is selected, zstd being
+ *		preferred when both are equally acceptable
+ */
+// ----------------------------------------------------------------------
+
+Compression getCompression(const Spine::HTTP::Request &req,
+                           const Config &config,
+                           const Producer &producer,
+                           OutputFormat outputFormat)
+{
+  try
+  {
+    Compression compression;
+    compression.chunkTimeBudget = config.getChunkTimeBudget();
+
+    if ((outputFormat != NetCdf) && (outputFormat != QD))
+      return compression;
+
+    string format = ((outputFormat == NetCdf) ? "netcdf" : "qd");
+    int gzipLevel = config.getCompressionLevel(producer, format + ".gzip");
+    int zstdLevel = config.getCompressionLevel(producer, format + ".zstd");
+
+    if ((gzipLevel == 0) && (zstdLevel == 0))
+      return compression;
+
+    compression.negotiable = true;
+
+    auto acceptEncoding = req.getHeader("Accept-Encoding");
+
+    if (!acceptEncoding)
+      return compression;
+
+    double gzipQuality = ((gzipLevel > 0) ? acceptedQuality(*acceptEncoding, "gzip") : 0);
+    double zstdQuality = ((zstdLevel > 0) ? acceptedQuality(*acceptEncoding, "zstd") : 0);
+
+    if ((zstdQuality > 0) && (zstdQuality >= gzipQuality))
+    {
+      compression.encoding = ContentEncoding::Zstd;
+      compression.level = zstdLevel;
+      compression.threads = config.getZstdThreads();
+      compression.minThreadedSize = config.getZstdThreadedSize();
+    }
+    else if (gzipQuality > 0)
+    {
+      compression.encoding = ContentEncoding::Gzip;
+      compression.level = gzipLevel;
+    }
+
+    return compression;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Initialize compression stream.
+ *
+ *		zstd worker threads are used if the (estimated) output size is
+ *		large enough. If libzstd does not support multithreading, the
+ *		output is compressed in the calling thread
+ */
+// ----------------------------------------------------------------------
+
+CompressingStreamer::CompressingStreamer(
+    const std::shared_ptr<Spine::HTTP::ContentStreamer> &streamer,
+    const Compression &compression,
+    const std::optional<std::size_t> &sizeHint)
+    : Spine::HTTP::ContentStreamer(),
+      itsStreamer(streamer),
+      itsEncoding(compression.encoding),
+      itsChunkTimeBudget(compression.chunkTimeBudget)
+{
+  try
+  {
+    if (itsEncoding == ContentEncoding::Gzip)
+    {
+      memset(&itsGzipStream, 0, sizeof(itsGzipStream));
+
+      // windowBits 15 + 16 for gzip header and trailer
+
+      if (deflateInit2(&itsGzipStream,
+                       compression.level,
+                       Z_DEFLATED,
+                       15 + 16,
+                       8,
+                       Z_DEFAULT_STRATEGY) != Z_OK)
+        throw Fmi::Exception(BCP, "Gzip compression initialization failed");
+
+      itsGzipInitialized = true;
+    }
+    else if (itsEncoding == ContentEncoding::Zstd)
+    {
+      itsZstdContext = ZSTD_createCCtx();
+
+      if (!itsZstdContext)
+        throw Fmi::Exception(BCP, "Zstd compression initialization failed");
+
+      auto ret =
+          ZSTD_CCtx_setParameter(itsZstdContext, ZSTD_c_compressionLevel, compression.level);
+
+      if (ZSTD_isError(ret))
+        throw Fmi::Exception(BCP, "Zstd compression initialization failed")
+            .addParameter("Error", ZSTD_getErrorName(ret));
+
+      if ((compression.threads > 0) && sizeHint && (*sizeHint >= compression.minThreadedSize))
+        ZSTD_CCtx_setParameter(itsZstdContext, ZSTD_c_nbWorkers, compression.threads);
+    }
+    else
+      throw Fmi::Exception(BCP, "Compressing streamer: no compression");
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+CompressingStreamer::~CompressingStreamer()
+{
+  if (itsGzipInitialized)
+    deflateEnd(&itsGzipStream);
+
+  if (itsZstdContext)
+    ZSTD_freeCCtx(itsZstdContext);
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Compress data chunk appending the compressed data to output.
+ *
+ *		With Flush::Sync all data compressed so far is output (the client
+ *		can decode it), with Flush::End the compression stream is ended
+ */
+// ----------------------------------------------------------------------
+
+void CompressingStreamer::compress(const std::string &chunk, Flush flush, std::string &output)
+{
+  try
+  {
+    if (itsEncoding == ContentEncoding::Gzip)
+    {
+      itsGzipStream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(chunk.data()));
+      itsGzipStream.avail_in = chunk.size();
+
+      while (true)
+      {
+        auto offset = output.size();
+        output.resize(offset + gzipOutputBufferSize);
+
+        itsGzipStream.next_out = reinterpret_cast<Bytef *>(&output[offset]);
+        itsGzipStream.avail_out = gzipOutputBufferSize;
+
+        auto ret = deflate(&itsGzipStream,
+                           ((flush == Flush::End)    ? Z_FINISH
+                            : (flush == Flush::Sync) ? Z_SYNC_FLUSH
+                                                     : Z_NO_FLUSH));
+
+        if (ret == Z_STREAM_ERROR)
+          throw Fmi::Exception(BCP, "Gzip compression failed");
+
+        output.resize(offset + gzipOutputBufferSize - itsGzipStream.avail_out);
+
+        if ((flush == Flush::End) ? (ret == Z_STREAM_END) : (itsGzipStream.avail_out != 0))
+          break;
+      }
+    }
+    else
+    {
+      ZSTD_inBuffer in = {chunk.data(), chunk.size(), 0};
+      auto bufferSize = ZSTD_CStreamOutSize();
+
+      while (true)
+      {
+        auto offset = output.size();
+        output.resize(offset + bufferSize);
+
+        ZSTD_outBuffer out = {&output[offset], bufferSize, 0};
+        auto remaining = ZSTD_compressStream2(itsZstdContext,
+                                              &out,
+                                              &in,
+                                              ((flush == Flush::End)    ? ZSTD_e_end
+                                               : (flush == Flush::Sync) ? ZSTD_e_flush
+                                                                        : ZSTD_e_continue));
+
+        if (ZSTD_isError(remaining))
+          throw Fmi::Exception(BCP, "Zstd compression failed")
+              .addParameter("Error", ZSTD_getErrorName(remaining));
+
+        output.resize(offset + out.pos);
+
+        if ((flush == Flush::None) ? (in.pos == in.size) : (remaining == 0))
+          break;
+      }
+    }
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Get next chunk of compressed data.
+ *
+ *		Data is read until some compressed output is available, since an
+ *		empty chunk would end the response. If the chunk time budget is
+ *		exceeded before that, the compressor is flushed to output the data
+ *		compressed so far
+ */
+// ----------------------------------------------------------------------
+
+std::string CompressingStreamer::getChunk()
+{
+  try
+  {
+    try
+    {
+      string output;
+      auto startTime = std::chrono::steady_clock::now();
+
+      while (output.empty())
+      {
+        auto chunk = itsStreamer->getChunk();
+        auto status = itsStreamer->getStatus();
+
+        if (status == ContentStreamer::StreamerStatus::EXIT_ERROR)
+        {
+          setStatus(status);
+          return "";
+        }
+
+        if (status == ContentStreamer::StreamerStatus::EXIT_OK)
+        {
+          compress(chunk, Flush::End, output);
+          setStatus(status);
+          break;
+        }
+
+        bool budgetExceeded = ((itsChunkTimeBudget > 0) &&
+                               ((std::chrono::steady_clock::now() - startTime) >=
+                                std::chrono::milliseconds(itsChunkTimeBudget)));
+
+        compress(chunk, (budgetExceeded ? Flush::Sync : Flush::None), output);
+      }
+
+      return output;
+    }
+    catch (...)
+    {
+      Fmi::Exception exception(BCP, "Request processing exception!", nullptr);
+      std::cerr << exception.getStackTrace();
+
+      setStatus(ContentStreamer::StreamerStatus::EXIT_ERROR);
+      return "";
+    }
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Set (compressed) content and related headers to the response
+ */
+// ----------------------------------------------------------------------
+
+std::optional<std::size_t> setCompressedContent(
+    Spine::HTTP::Response &theResponse,
+    const std::shared_ptr<Spine::HTTP::ContentStreamer> &content,
+    const Compression &compression,
+    const std::optional<std::size_t> &outputSize,
+    const std::optional<std::size_t> &estimatedOutputSize)
+{
+  try
+  {
+    if (compression.negotiable)
+      theResponse.setHeader("Vary", "Accept-Encoding");
+
+    if (!compression.enabled())
+    {
+      theResponse.setContent(content);
+
+      if (outputSize)
+        theResponse.setHeader("Content-Length", Fmi::to_string(*outputSize));
+
+      return outputSize;
+    }
+
+    auto sizeHint = (outputSize ? outputSize : estimatedOutputSize);
+
+    theResponse.setContent(std::make_shared<CompressingStreamer>(content, compression, sizeHint));
+    theResponse.setHeader("Content-Encoding", compression.name());
+
+    return std::nullopt;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+}  // namespace Download
+}  // namespace Plugin
+}  // namespace SmartMet
@@ -0,0 +1,122 @@
+// ======================================================================
+/*!
+ * \brief SmartMet download service plugin; HTTP content encoding
+ *        (streaming gzip/zstd compression of the output)
+ */
+// ======================================================================
+
+#pragma once
+
+#include "Config.h"
+#include "Query.h"
+#include <spine/HTTP.h>
+#include <zlib.h>
+#include <zstd.h>
+#include <memory>
+#include <optional>
+#include <string>
+
+namespace SmartMet
+{
+namespace Plugin
+{
+namespace Download
+{
+// ----------------------------------------------------------------------
+/*!
+ * \brief Content encoding (compression) of the response
+ */
+// ----------------------------------------------------------------------
+
+enum class ContentEncoding
+{
+  Identity,
+  Gzip,
+  Zstd
+};
+
+struct Compression
+{
+  ContentEncoding encoding = ContentEncoding::Identity;
+  int level = 0;
+  unsigned int threads = 0;          // zstd worker threads for large outputs; 0: single threaded
+  std::size_t minThreadedSize = 0;   // Minimum (estimated) output size for using worker threads
+  unsigned int chunkTimeBudget = 0;  // milliseconds; if 0, no limit
+  bool negotiable = false;           // Set if the encoding depends on Accept-Encoding header
+
+  bool enabled() const { return (encoding != ContentEncoding::Identity); }
+  std::string name() const;  // Content-Encoding header value
+};
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Select content encoding based on request's Accept-Encoding
+ *        header and configured compression levels.
+ *
+ *        Only NetCDF and querydata outputs are compressed; grib data
+ *        is already packed
+ */
+// ----------------------------------------------------------------------
+
+Compression getCompression(const Spine::HTTP::Request &req,
+                           const Config &config,
+                           const Producer &producer,
+                           OutputFormat outputFormat);
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Compress the output of another streamer
+ */
+// ----------------------------------------------------------------------
+
+class CompressingStreamer : public Spine::HTTP::ContentStreamer
+{
+ public:
+  CompressingStreamer(const std::shared_ptr<Spine::HTTP::ContentStreamer> &streamer,
+                      const Compression &compression,
+                      const std::optional<std::size_t> &sizeHint);
+  virtual ~CompressingStreamer();
+
+  virtual std::string getChunk();
+
+ private:
+  CompressingStreamer();
+
+  enum class Flush
+  {
+    None,  // Compressor may buffer the data
+    Sync,  // All data compressed so far is output
+    End    // Compression stream is ended
+  };
+
+  void compress(const std::string &chunk, Flush flush, std::string &output);
+
+  std::shared_ptr<Spine::HTTP::ContentStreamer> itsStreamer;
+  ContentEncoding itsEncoding;
+  unsigned int itsChunkTimeBudget;
+
+  z_stream itsGzipStream;
+  bool itsGzipInitialized = false;
+  ZSTD_CCtx *itsZstdContext = nullptr;
+};
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Set compressed content and Content-Encoding related headers
+ *        to the response.
+ *
+ *        Content-Length is not set for compressed content; returns the
+ *        output size to be used in response headers
+ */
+// ----------------------------------------------------------------------
+
+std::optional<std::size_t> setCompressedContent(
+    Spine::HTTP::Response &theResponse,
+    const std::shared_ptr<Spine::HTTP::ContentStreamer> &content,
+    const Compression &compression,
+    const std::optional<std::size_t> &outputSize,
+    const std::optional<std::size_t> &estimatedOutputSize);
+
+}  // namespace Download
+}  // namespace Plugin
+}  // namespace SmartMet
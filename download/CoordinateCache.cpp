@@ -0,0 +1,129 @@
+// ======================================================================
+/*!
+ * \brief SmartMet download service plugin; cache of computed output
+ *        grid coordinates
+ */
+// ======================================================================
+
+#include "CoordinateCache.h"
+#include <macgyver/Exception.h>
+
+using namespace std;
+
+namespace SmartMet
+{
+namespace Plugin
+{
+namespace Download
+{
+// ----------------------------------------------------------------------
+/*!
+ * \brief Get approximate memory usage of the coordinates
+ */
+// ----------------------------------------------------------------------
+
+std::size_t GridCoordinates::size() const
+{
+  std::size_t size = sizeof(*this);
+
+  for (auto const *matrix : {&srcLatLons, &targetLatLons, &targetWorldXYs})
+    size += 2 * sizeof(double) * matrix->width() * matrix->height();
+
+  size += sizeof(double) * (rotLongitudes.size() + rotLatitudes.size());
+
+  return size;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Initialize the cache
+ */
+// ----------------------------------------------------------------------
+
+void CoordinateCache::init(std::size_t maxSize)
+{
+  itsMaxSize = maxSize;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Find cached coordinates for given geometry
+ */
+// ----------------------------------------------------------------------
+
+std::shared_ptr<const GridCoordinates> CoordinateCache::find(const std::string &geometryKey)
+{
+  try
+  {
+    if (!enabled())
+      return nullptr;
+
+    std::lock_guard<std::mutex> lock(itsMutex);
+
+    auto it = itsEntries.find(geometryKey);
+
+    if (it == itsEntries.end())
+      return nullptr;
+
+    itsLruList.splice(itsLruList.begin(), itsLruList, it->second.lruPosition);
+
+    return it->second.coordinates;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Cache coordinates for given geometry.
+ *
+ *		Coordinates larger than the cache size limit are not cached.
+ *		Least recently used entries are removed to keep the cache size
+ *		within the limit
+ */
+// ----------------------------------------------------------------------
+
+void CoordinateCache::insert(const std::string &geometryKey,
+                             const std::shared_ptr<const GridCoordinates> &coordinates)
+{
+  try
+  {
+    if (!enabled())
+      return;
+
+    auto size = coordinates->size();
+
+    if (size > itsMaxSize)
+      return;
+
+    std::lock_guard<std::mutex> lock(itsMutex);
+
+    // Concurrent requests for the same geometry may have cached the coordinates already
+
+    if (itsEntries.find(geometryKey) != itsEntries.end())
+      return;
+
+    while ((!itsLruList.empty()) && ((itsSize + size) > itsMaxSize))
+    {
+      auto it = itsEntries.find(itsLruList.back());
+
+      itsSize -= it->second.coordinates->size();
+      itsEntries.erase(it);
+      itsLruList.pop_back();
+    }
+
+    itsLruList.push_front(geometryKey);
+    itsEntries.insert(make_pair(geometryKey, Entry{coordinates, itsLruList.begin()}));
+    itsSize += size;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+}  // namespace Download
+}  // namespace Plugin
+}  // namespace SmartMet
@@ -0,0 +1,96 @@
+// ======================================================================
+/*!
+ * \brief SmartMet download service plugin; cache of computed output
+ *        grid coordinates
+ */
+// ======================================================================
+
+#pragma once
+
+#include "Tools.h"
+#include <gis/CoordinateMatrix.h>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace SmartMet
+{
+namespace Plugin
+{
+namespace Download
+{
+// ----------------------------------------------------------------------
+/*!
+ * \brief Computed coordinates of an output grid geometry.
+ *
+ *        Querydata source and target grid latlons/projected coordinates
+ *        and the target bounding box, or grid data's rotated latlon
+ *        coordinates
+ */
+// ----------------------------------------------------------------------
+
+struct GridCoordinates
+{
+  Fmi::CoordinateMatrix srcLatLons;      // Source grid latlons
+  Fmi::CoordinateMatrix targetLatLons;   // Target grid latlons (netcdf output)
+  Fmi::CoordinateMatrix targetWorldXYs;  // Target grid projected coordinates (netcdf output)
+  BBoxCorners boundingBox;               // Target projection latlon bounding box
+
+  std::vector<double> rotLongitudes;  // Rotated coords for grid data rotlat grid
+  std::vector<double> rotLatitudes;   //
+
+  std::size_t size() const;  // Approximate memory usage in bytes
+};
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Memory cache of computed grid coordinates.
+ *
+ *        Coordinates are cached by geometry key (source and target
+ *        spatial references, bounding box and grid size) for use by
+ *        subsequent requests for the same geometry. When the cache size
+ *        limit is exceeded, least recently used entries are removed.
+ */
+// ----------------------------------------------------------------------
+
+class CoordinateCache
+{
+ public:
+  CoordinateCache() = default;
+  CoordinateCache(const CoordinateCache &other) = delete;
+  CoordinateCache &operator=(const CoordinateCache &other) = delete;
+
+  void init(std::size_t maxSize);
+
+  bool enabled() const { return (itsMaxSize > 0); }
+
+  // Returns cached coordinates or nullptr if not cached
+
+  std::shared_ptr<const GridCoordinates> find(const std::string &geometryKey);
+
+  void insert(const std::string &geometryKey,
+              const std::shared_ptr<const GridCoordinates> &coordinates);
+
+ private:
+  using LruList = std::list<std::string>;
+
+  struct Entry
+  {
+    std::shared_ptr<const GridCoordinates> coordinates;
+    LruList::iterator lruPosition;
+  };
+
+  std::size_t itsMaxSize = 0;  // If 0, the cache is disabled
+  std::size_t itsSize = 0;     // Total size of the cached coordinates
+
+  std::mutex itsMutex;
+  std::map<std::string, Entry> itsEntries;
+  LruList itsLruList;  // Geometry keys, most recently used first
+};
+
+}  // namespace Download
+}  // namespace Plugin
+}  // namespace SmartMet
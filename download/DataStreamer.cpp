@@ -8,6 +8,7 @@
 #include "Datum.h"
 #include "Plugin.h"
 #include <boost/algorithm/string/split.hpp>
+#include <boost/functional/hash.hpp>
 #include <gis/ProjInfo.h>
 #include <gis/SpatialReference.h>
 #include <grid-files/identification/GridDef.h>
@@ -22,7 +23,12 @@
 #include <newbase/NFmiTimeList.h>
 #include <sys/types.h>
 #include <ogr_geometry.h>
+#include <algorithm>
+#include <atomic>
+#include <ctime>
+#include <exception>
 #include <string>
+#include <thread>
 #include <unistd.h>
 #include <unordered_set>
 
@@ -30,9 +36,30 @@ static const uint minChunkLengthInBytes = 256 * 256;    // Min length of data ch
 static const uint maxChunkLengthInBytes = 2048 * 2048;  // Max length of data chunk to return
 static const uint maxMsgChunks = 30;  // Max # of data chunks collected and returned as one chunk
 static const uint maxGridQueryBlockSize = 30;  // Max # of grid params/timesteps fetched as a block
+static const uint gridValuesBlockGridsPerThread = 2;  // # of grids per thread in parallel extraction
 
 using namespace std;
 
+namespace
+{
+// Set when all requests are to be cancelled (shutdown)
+std::atomic<bool> cancelAllRequests{false};
+
+// Estimated total cpu time saved by cancelling requests
+std::atomic<unsigned long long> savedCpuMilliseconds{0};
+
+double threadCpuTime()
+{
+  struct timespec ts;
+
+  if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) != 0)
+    return 0;
+
+  return ts.tv_sec + (ts.tv_nsec / 1.0e9);
+}
+
+}  // namespace
+
 namespace SmartMet
 {
 namespace Plugin
@@ -97,6 +124,27 @@ DataStreamer::DataStreamer(const Spine::HTTP::Request &req,
 
 DataStreamer::~DataStreamer() {}
 
+// ----------------------------------------------------------------------
+/*!
+ * \brief Check if the time spent generating current chunk exceeds the configured budget.
+ *
+ *		Streamers return the data generated so far when the budget is exceeded to
+ *		yield the server thread and to get the data flowing to the client
+ */
+// ----------------------------------------------------------------------
+
+bool DataStreamer::chunkTimeBudgetExceeded(
+    const std::chrono::steady_clock::time_point &startTime) const
+{
+  auto chunkTimeBudget = itsCfg.getChunkTimeBudget();
+
+  if (chunkTimeBudget == 0)
+    return false;
+
+  return ((std::chrono::steady_clock::now() - startTime) >=
+          std::chrono::milliseconds(chunkTimeBudget));
+}
+
 // ----------------------------------------------------------------------
 /*!
  * \brief Determine data timestep
@@ -1119,11 +1167,9 @@ void DataStreamer::getParameterDetailsFromContentData(
     if (!isValidGeneration(&(generationInfo->second)))
       return;
 
-    vector<string> paramParts;
-    itsQuery.parseRadonParameterName(paramName, paramParts);
-
-    const string &param = paramParts[0];
-    const string &producer = paramParts[1];
+    const auto &radonParameter = itsQuery.getRadonParameter(paramName);
+    const string &param = radonParameter.name;
+    const string &producer = radonParameter.producer;
 
     typedef map<T::GeometryId, SmartMet::Engine::Grid::ParameterDetails_vec> GeomDetails;
     typedef map<T::ParamLevel, GeomDetails> LevelDetails;
@@ -1517,6 +1563,129 @@ bool DataStreamer::hasRequestedGridData(const Producer &producer,
   }
 }
 
+// ----------------------------------------------------------------------
+/*!
+ * \brief Check if querydata is requested as is (native projection and grid,
+ *        all parameters, levels and validtimes in native order) with qd output,
+ *        in which case the source file can be returned without extracting
+ *        the data.
+ *
+ *        Must be called after generateValidTimeList() and setLevels().
+ */
+// ----------------------------------------------------------------------
+
+bool DataStreamer::isNativeQueryDataRequest() const
+{
+  try
+  {
+    if ((itsReqParams.dataSource != QueryData) || (itsReqParams.outputFormat != QD) ||
+        itsMultiFile || (!itsQ))
+      return false;
+
+    if ((!itsReqParams.projection.empty()) || (!itsReqParams.bbox.empty()) ||
+        (!itsReqParams.gridCenter.empty()) || (!itsReqParams.gridSize.empty()) ||
+        (!itsReqParams.gridResolution.empty()) || (!itsReqParams.gridStep.empty()) ||
+        (itsReqParams.datumShift != Datum::DatumShift::None))
+      return false;
+
+    auto q = itsQ;
+
+    // All parameters in querydata order
+
+    auto it = itsDataParams.begin();
+
+    for (q->resetParam(); q->nextParam(); it++)
+      if ((it == itsDataParams.end()) || (it->number() != q->parameterName()))
+        return false;
+
+    if (it != itsDataParams.end())
+      return false;
+
+    // All levels in querydata order; the levels are output in sorted (rising or falling) order
+
+    if (!isSurfaceLevel(itsLevelType))
+    {
+      auto itl = itsSortedDataLevels.begin();
+
+      for (q->resetLevel(); q->nextLevel(); itl++)
+        if ((itl == itsSortedDataLevels.end()) ||
+            (*itl != boost::numeric_cast<int>(abs(q->levelValue()))))
+          return false;
+
+      if (itl != itsSortedDataLevels.end())
+        return false;
+    }
+
+    q->firstLevel();
+
+    // All validtimes
+
+    auto validTimes = q->validTimes();
+
+    if (validTimes->size() != itsDataTimes.size())
+      return false;
+
+    auto itt = itsDataTimes.begin();
+
+    for (auto const &validTime : *validTimes)
+      if ((itt++)->utc_time() != validTime)
+        return false;
+
+    // Let the normal extraction path report too large requests
+
+    unsigned long numValues = itsDataParams.size() * itsDataLevels.size() * itsDataTimes.size() *
+                              q->grid().XNumber() * q->grid().YNumber();
+
+    return (numValues <= itsCfg.getMaxRequestDataValues());
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Estimate request cost.
+ *
+ *        Must be called after hasRequestedData() (the first grid has been
+ *        loaded and target grid size is known).
+ */
+// ----------------------------------------------------------------------
+
+RequestCost DataStreamer::estimateCost() const
+{
+  try
+  {
+    bool gridContent = (itsReqParams.dataSource == GridContent);
+    bool interpolated;
+
+    if (itsReqParams.dataSource == QueryData)
+      interpolated = (!(itsUseNativeProj && itsUseNativeGridSize));
+    else
+      interpolated = ((!itsReqParams.projection.empty()) || (!itsReqParams.geometryId.empty()) ||
+                      (!itsReqParams.gridSize.empty()) || (!itsReqParams.gridResolution.empty()));
+
+    auto gridSize = (itsCropping.crop ? itsCropping.gridSizeX * itsCropping.gridSizeY
+                                      : itsReqGridSizeX * itsReqGridSizeY);
+
+    // With grid content data each parameter has a single level
+
+    return estimateRequestCost(itsReqParams,
+                               itsDataParams.size(),
+                               gridContent ? 1 : itsDataLevels.size(),
+                               itsDataTimes.size(),
+                               gridSize,
+                               interpolated,
+                               getOutputSize(),
+                               getEstimatedOutputSize());
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
 // ----------------------------------------------------------------------
 /*!
  * \brief Check if (any) requested data is available.
@@ -2517,6 +2686,40 @@ void DataStreamer::setTransformedCoordinates(Engine::Querydata::Q q, const NFmiA
 
     getBBox(q, *sourceArea, *wgs84PrSrsPtr, !wgs84ProjLL ? wgs84LLSrsPtr : nullptr);
 
+    NFmiPoint bl = itsBoundingBox.bottomLeft;
+    NFmiPoint tr = itsBoundingBox.topRight;
+
+    // Use cached coordinates if available for the geometry (source and target cs, bounding box
+    // and grid size)
+
+    string geometryKey;
+
+    if (itsCoordinateCache && itsCoordinateCache->enabled())
+    {
+      geometryKey = getWKT(qdLLSrsPtr) + ";" + getWKT(wgs84PrSrsPtr) + ";" +
+                    Fmi::to_string(int(itsReqParams.datumShift)) + ";" +
+                    Fmi::to_string(bl.X()) + "," + Fmi::to_string(bl.Y()) + "," +
+                    Fmi::to_string(tr.X()) + "," + Fmi::to_string(tr.Y()) + ";" +
+                    Fmi::to_string(itsReqGridSizeX) + "x" + Fmi::to_string(itsReqGridSizeY) +
+                    (qdProjLL ? ";qdll" : "") + (wgs84ProjLL ? ";ll" : "") +
+                    ((itsReqParams.outputFormat == NetCdf) ? ";nc" : "");
+
+      auto coordinates = itsCoordinateCache->find(geometryKey);
+
+      if (coordinates)
+      {
+        itsSrcLatLons = coordinates->srcLatLons;
+        itsTargetLatLons = coordinates->targetLatLons;
+        itsTargetWorldXYs = coordinates->targetWorldXYs;
+        itsBoundingBox = coordinates->boundingBox;
+
+        itsDX = fabs((tr.X() - bl.X()) / itsReqGridSizeX);
+        itsDY = fabs((tr.Y() - bl.Y()) / itsReqGridSizeY);
+
+        return;
+      }
+    }
+
     // Transform output cs grid cell projected (or latlon) coordinates to qd latlons.
     //
     // Get transformations from projected (or latlon) target cs to qd latlon cs and from projected
@@ -2535,9 +2738,6 @@ void DataStreamer::setTransformedCoordinates(Engine::Querydata::Q q, const NFmiA
     typedef NFmiDataMatrix<float>::size_type sz_t;
     double xc, yc;
 
-    NFmiPoint bl = itsBoundingBox.bottomLeft;
-    NFmiPoint tr = itsBoundingBox.topRight;
-
     itsSrcLatLons = Fmi::CoordinateMatrix(itsReqGridSizeX, itsReqGridSizeY);
     const sz_t xs = itsSrcLatLons.width();
     const sz_t ys = itsSrcLatLons.height();
@@ -2620,6 +2820,18 @@ void DataStreamer::setTransformedCoordinates(Engine::Querydata::Q q, const NFmiA
 
     itsDX = fabs((tr.X() - bl.X()) / xs);
     itsDY = fabs((tr.Y() - bl.Y()) / ys);
+
+    if (!geometryKey.empty())
+    {
+      auto coordinates = std::make_shared<GridCoordinates>();
+
+      coordinates->srcLatLons = itsSrcLatLons;
+      coordinates->targetLatLons = itsTargetLatLons;
+      coordinates->targetWorldXYs = itsTargetWorldXYs;
+      coordinates->boundingBox = itsBoundingBox;
+
+      itsCoordinateCache->insert(geometryKey, coordinates);
+    }
   }
   catch (...)
   {
@@ -3067,16 +3279,17 @@ static void valBufDeleter(float *ptr)
   }
 }
 
-void DataStreamer::cachedProjGridValues(Engine::Querydata::Q q,
-                                        NFmiGrid &wantedGrid,
-                                        const NFmiMetTime *mt)
+// ----------------------------------------------------------------------
+/*!
+ * \brief Create target querydata and location cache for interpolating
+ *        values to nonnative grid
+ */
+// ----------------------------------------------------------------------
+
+void DataStreamer::initLocationCache(Engine::Querydata::Q q, const NFmiGrid &wantedGrid)
 {
   try
   {
-    unsigned long xs = wantedGrid.XNumber();
-
-    itsGridValues.Resize(xs, wantedGrid.YNumber(), kFloatMissing);
-
     // Target querydata is needed for the interpolation. It will be used for the data output too if
     // qd format was selected.
 
@@ -3090,6 +3303,34 @@ void DataStreamer::cachedProjGridValues(Engine::Querydata::Q q,
       NFmiFastQueryInfo tqi(itsQueryData.get());
       q->calcLatlonCachePoints(tqi, itsLocCache);
     }
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Get grid values using cached locations.
+ *
+ *		The location cache must be initialized beforehand when called
+ *		from worker threads
+ */
+// ----------------------------------------------------------------------
+
+void DataStreamer::cachedProjGridValues(Engine::Querydata::Q q,
+                                        NFmiGrid &wantedGrid,
+                                        const NFmiMetTime *mt,
+                                        NFmiDataMatrix<float> &values)
+{
+  try
+  {
+    unsigned long xs = wantedGrid.XNumber();
+
+    values.Resize(xs, wantedGrid.YNumber(), kFloatMissing);
+
+    initLocationCache(q, wantedGrid);
 
     // Get time cache
 
@@ -3181,7 +3422,7 @@ void DataStreamer::cachedProjGridValues(Engine::Querydata::Q q,
             value = ((id == kFmiWindUMS) ? uu : vv);
           }
 
-          itsGridValues[x][y] = boost::numeric_cast<float>(value);
+          values[x][y] = boost::numeric_cast<float>(value);
         }
 
       if (!q->param(id))
@@ -3199,7 +3440,7 @@ void DataStreamer::cachedProjGridValues(Engine::Querydata::Q q,
         for (x = x0; (x < xN); x += xStep)
         {
           NFmiLocationCache &lc = itsLocCache[x][y];
-          itsGridValues[x][y] = (mt ? q->cachedInterpolation(lc, tc) : q->cachedInterpolation(lc));
+          values[x][y] = (mt ? q->cachedInterpolation(lc, tc) : q->cachedInterpolation(lc));
         }
       }
     }
@@ -3736,7 +3977,7 @@ void DataStreamer::nextParam(Engine::Querydata::Q q)
 // ----------------------------------------------------------------------
 
 Engine::Querydata::Q DataStreamer::getCurrentParamQ(
-    const std::list<FmiParameterName> &currentParams) const
+    const std::list<FmiParameterName> &currentParams, Engine::Querydata::SharedModel &model) const
 {
   try
   {
@@ -3791,7 +4032,7 @@ Engine::Querydata::Q DataStreamer::getCurrentParamQ(
     itsQ->levelIndex(levelIndex);
 
     std::size_t hash = 0;
-    auto model = Engine::Querydata::Model::create(data, hash);
+    model = Engine::Querydata::Model::create(data, hash);
 
     return std::make_shared<Engine::Querydata::QImpl>(model);
   }
@@ -3801,6 +4042,115 @@ Engine::Querydata::Q DataStreamer::getCurrentParamQ(
   }
 }
 
+// ----------------------------------------------------------------------
+/*!
+ * \brief Cancel data extraction of all requests
+ *
+ */
+// ----------------------------------------------------------------------
+
+void DataStreamer::cancelAll()
+{
+  cancelAllRequests = true;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Check if data extraction is to be cancelled (the request's max
+ *        processing time is exceeded or all requests are cancelled on
+ *        shutdown). Can be called by extraction worker threads.
+ *
+ *		Processing time is the time used for extracting the data; a slow
+ *		client reading the output does not consume it
+ */
+// ----------------------------------------------------------------------
+
+bool DataStreamer::cancellationRequested() const
+{
+  if (cancelAllRequests)
+    return true;
+
+  if (itsCfg.getMaxRequestTime() == 0)
+    return false;
+
+  auto processingTime = itsProcessingTime;
+
+  if (itsExtractionStartTime)
+    processingTime += (std::chrono::steady_clock::now() - *itsExtractionStartTime);
+
+  return (processingTime >= std::chrono::seconds(itsCfg.getMaxRequestTime()));
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Check if data extraction is to be cancelled.
+ *
+ *		Extraction is cancelled when the request's max processing time is
+ *		exceeded or when all requests are cancelled on shutdown. The cpu time
+ *		saved is estimated using the average cpu time of the grids extracted
+ *		so far. Throws if cancelled
+ */
+// ----------------------------------------------------------------------
+
+void DataStreamer::checkCancellation()
+{
+  if (!cancellationRequested())
+    return;
+
+  itsCancelledFlag = true;
+
+  std::size_t nGrids = itsDataParams.size() * itsDataTimes.size() *
+                       ((itsReqParams.dataSource == GridContent) ? 1 : itsDataLevels.size());
+  double cpuTimeSaved = 0;
+
+  if ((itsExtractedGrids > 0) && (nGrids > itsExtractedGrids))
+    cpuTimeSaved = itsExtractionCpuTime * (nGrids - itsExtractedGrids) / itsExtractedGrids;
+
+  auto totalSaved = (savedCpuMilliseconds += static_cast<unsigned long long>(cpuTimeSaved * 1000));
+
+  fprintf(stderr,
+          "Request cancelled after %lu/%lu grids, %.1f cpu seconds saved (total %.1f); '%s'\n",
+          itsExtractedGrids,
+          nGrids,
+          cpuTimeSaved,
+          totalSaved / 1000.0,
+          itsRequest.getURI().c_str());
+
+  throw Fmi::Exception(BCP, "Request cancelled");
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Check if grids can be skipped without affecting the following
+ *        grids.
+ *
+ *		Only querydata grids are skipped; manual cropping may get set by
+ *		time interpolation, affecting the extraction of the following
+ *		validtimes
+ */
+// ----------------------------------------------------------------------
+
+bool DataStreamer::canSkipGrids() const
+{
+  return ((itsReqParams.dataSource == QueryData) && ((!itsCropping.crop) || itsCropping.cropMan));
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Skip given number of grids (the first one extracted at
+ *        initialization and the following ones) without extracting them
+ */
+// ----------------------------------------------------------------------
+
+void DataStreamer::skipGrids(std::size_t nGrids)
+{
+  if (nGrids == 0)
+    return;
+
+  itsDataChunk.clear();
+  itsSkipGrids = nGrids - 1;
+}
+
 // ----------------------------------------------------------------------
 /*!
  * \brief Extract data
@@ -3822,12 +4172,53 @@ void DataStreamer::extractData(string &chunk)
       return;
     }
 
+    checkCancellation();
+
+    auto cpuTime = threadCpuTime();
+    itsExtractionStartTime = std::chrono::steady_clock::now();
+
+    // Grids preceding the requested byte range are skipped without extracting them
+
+    while (!extractGrid(chunk))
+      checkCancellation();
+
+    itsExtractionCpuTime += (threadCpuTime() - cpuTime);
+    itsProcessingTime += (std::chrono::steady_clock::now() - *itsExtractionStartTime);
+    itsExtractionStartTime.reset();
+
+    // The request's share of the admission budget is released when all data has been
+    // extracted; the rest of the output is returned from buffers or the output file
+
+    if (!chunk.empty())
+      itsExtractedGrids++;
+    else
+      itsAdmissionTicket.reset();
+  }
+  catch (...)
+  {
+    itsAdmissionTicket.reset();
+
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Extract next grid. Returns false if the grid was skipped
+ *
+ */
+// ----------------------------------------------------------------------
+
+bool DataStreamer::extractGrid(string &chunk)
+{
+  try
+  {
     chunk.clear();
 
     if (itsReqParams.dataSource != QueryData)
     {
       extractGridData(chunk);
-      return;
+      return true;
     }
 
     auto theParamsEnd = itsDataParams.end();
@@ -3941,7 +4332,7 @@ void DataStreamer::extractData(string &chunk)
               // No need to reset param (to 'id') here, will be set by call to getCurrentParamQ
             }
 
-            itsCPQ = getCurrentParamQ(currentParams);
+            itsCPQ = getCurrentParamQ(currentParams, itsCPQModel);
           }
 
           // Set level if not interpolated, time index gets set (or is not used) below
@@ -3952,47 +4343,36 @@ void DataStreamer::extractData(string &chunk)
           q = itsCPQ;
         }
 
-        if (itsReqParams.datumShift == Datum::DatumShift::None)
+        if (itsSkipGrids > 0)
         {
-          // Using newbase projection.
-          //
-          if (exactLevel)
-          {
-            bool timeInterpolation = (!q->time(mt));
+          // Grid preceding the requested byte range; move to next time instant
 
-            if (timeInterpolation || nonNativeGrid)
-            {
-              if (nonNativeGrid)
-                cachedProjGridValues(q, *grid, timeInterpolation ? &mt : nullptr);
-              else
-              {
-                // Must manually crop the data if bounding was given
-                // ('cropMan' was not set by the call to getAreaAndGrid())
-                //
-                itsCropping.cropMan = itsCropping.crop;
-                itsGridValues = q->values(mt);
-              }
-            }
-            else
-            {
-              if (itsCropping.cropped && (!itsCropping.cropMan))
-                itsGridValues = q->croppedValues(itsCropping.bottomLeftX,
-                                                 itsCropping.bottomLeftY,
-                                                 itsCropping.topRightX,
-                                                 itsCropping.topRightY);
-              else
-                itsGridValues = q->values();
-            }
-          }
-          else if (nonNativeGrid)
-            itsGridValues = q->pressureValues(*grid, mt, level, q->isRelativeUV());
-          else
-            itsGridValues = q->pressureValues(mt, level);
+          itsSkipGrids--;
+          itsTimeIterator++;
+          itsTimeIndex++;
+
+          return false;
         }
+
+        // Get the values. With parallel extraction the values are extracted for a block of
+        // validtimes at once; not while manual cropping may get set by time interpolation,
+        // since it affects the extraction of the following validtimes
+
+        bool cropMan = false;
+
+        if (itsParallelExtraction && itsExtractionPool && (itsExtractionPool->size() > 1) &&
+            (!itsMultiFile) && ((!itsCropping.crop) || itsCropping.cropMan))
+          getGridValuesFromBlock(q, grid, level, exactLevel, nonNativeGrid, cropMan);
         else
-          // Using gdal/proj4 projection.
+          getGridValues(q, grid, level, exactLevel, nonNativeGrid, mt, itsGridValues, cropMan);
+
+        if (cropMan)
+        {
+          // Must manually crop the data if bounding was given
+          // ('cropMan' was not set by the call to getAreaAndGrid())
           //
-          itsGridValues = q->values(itsSrcLatLons, mt, exactLevel ? kFloatMissing : level);
+          itsCropping.cropMan = itsCropping.crop;
+        }
 
         // Load the data chunk from 'itsGridValues'.
         //
@@ -4012,11 +4392,195 @@ void DataStreamer::extractData(string &chunk)
         itsTimeIterator++;
         itsTimeIndex++;
 
-        return;
+        return true;
       }  // for queried levels
     }    // for parameters
 
     // No more data
+
+    return true;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Get current parameter's grid values for given level and validtime.
+ *
+ *		Only the given Q and values are modified; cropMan is set if the
+ *		values must be cropped manually
+ */
+// ----------------------------------------------------------------------
+
+void DataStreamer::getGridValues(Engine::Querydata::Q q,
+                                 NFmiGrid *grid,
+                                 int level,
+                                 bool exactLevel,
+                                 bool nonNativeGrid,
+                                 const NFmiMetTime &mt,
+                                 NFmiDataMatrix<float> &values,
+                                 bool &cropMan)
+{
+  try
+  {
+    if (itsReqParams.datumShift == Datum::DatumShift::None)
+    {
+      // Using newbase projection.
+      //
+      if (exactLevel)
+      {
+        bool timeInterpolation = (!q->time(mt));
+
+        if (timeInterpolation || nonNativeGrid)
+        {
+          if (nonNativeGrid)
+            cachedProjGridValues(q, *grid, timeInterpolation ? &mt : nullptr, values);
+          else
+          {
+            cropMan = true;
+            values = q->values(mt);
+          }
+        }
+        else
+        {
+          if (itsCropping.cropped && (!itsCropping.cropMan))
+            values = q->croppedValues(itsCropping.bottomLeftX,
+                                      itsCropping.bottomLeftY,
+                                      itsCropping.topRightX,
+                                      itsCropping.topRightY);
+          else
+            values = q->values();
+        }
+      }
+      else if (nonNativeGrid)
+        values = q->pressureValues(*grid, mt, level, q->isRelativeUV());
+      else
+        values = q->pressureValues(mt, level);
+    }
+    else
+      // Using gdal/proj4 projection.
+      //
+      values = q->values(itsSrcLatLons, mt, exactLevel ? kFloatMissing : level);
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Get current parameter's grid values for current level and validtime
+ *        from the block of values extracted in parallel.
+ *
+ *		If the values are not available, the values for the current and
+ *		the following validtimes are extracted by pooled worker threads, each
+ *		using its own Q (and grid) for the current parameter's in-memory
+ *		querydata. The values are then stored in order by the caller
+ */
+// ----------------------------------------------------------------------
+
+void DataStreamer::getGridValuesFromBlock(Engine::Querydata::Q q,
+                                          NFmiGrid *grid,
+                                          int level,
+                                          bool exactLevel,
+                                          bool nonNativeGrid,
+                                          bool &cropMan)
+{
+  try
+  {
+    auto &block = itsGridValuesBlock;
+    long param = q->parameterName();
+
+    if ((block.param != param) || (block.levelIndex != itsLevelIndex) ||
+        (itsTimeIndex < block.firstTimeIndex) ||
+        (itsTimeIndex >= (block.firstTimeIndex + block.values.size())))
+    {
+      // Validtimes of the block; times later than the last available validtime are not
+      // extracted
+
+      std::vector<NFmiMetTime> times;
+      std::size_t maxBlockSize = itsExtractionPool->size() * gridValuesBlockGridsPerThread;
+
+      for (auto it = itsTimeIterator;
+           ((it != itsDataTimes.end()) && (times.size() < maxBlockSize) &&
+            (it->utc_time() <= itsLastDataTime));
+           it++)
+        times.push_back(NFmiMetTime(it->utc_time()));
+
+      block.param = -1;
+      block.levelIndex = itsLevelIndex;
+      block.firstTimeIndex = itsTimeIndex;
+      block.values.clear();
+      block.values.resize(times.size());
+      block.cropMan.assign(times.size(), 0);
+
+      // Location cache is shared by the workers
+
+      if ((itsReqParams.datumShift == Datum::DatumShift::None) && exactLevel && nonNativeGrid)
+        initLocationCache(q, *grid);
+
+      // The grids are extracted by the plugin's worker threads shared by all requests. The
+      // workers stop extracting when the request is cancelled
+
+      std::size_t nWorkers = std::min<std::size_t>(itsExtractionPool->size(), times.size());
+      std::vector<double> cpuTimes(nWorkers, 0);
+      std::vector<std::function<void()>> workers;
+
+      for (std::size_t w = 0; (w < nWorkers); w++)
+        workers.push_back([&, w]() {
+          auto cpuTime = threadCpuTime();
+
+          auto wq = std::make_shared<Engine::Querydata::QImpl>(itsCPQModel);
+          wq->param(param);
+
+          if (exactLevel)
+          {
+            int wLevel = level;
+            bool wExactLevel;
+
+            isLevelAvailable(wq, wLevel, wExactLevel);
+          }
+
+          std::unique_ptr<NFmiGrid> wGrid(grid ? new NFmiGrid(*grid) : nullptr);
+
+          for (std::size_t i = w; ((i < times.size()) && (!cancellationRequested()));
+               i += nWorkers)
+          {
+            bool wCropMan = false;
+
+            getGridValues(wq,
+                          wGrid.get(),
+                          level,
+                          exactLevel,
+                          nonNativeGrid,
+                          times[i],
+                          block.values[i],
+                          wCropMan);
+
+            block.cropMan[i] = wCropMan;
+          }
+
+          cpuTimes[w] = threadCpuTime() - cpuTime;
+        });
+
+      itsExtractionPool->run(workers);
+
+      for (auto cpuTime : cpuTimes)
+        itsExtractionCpuTime += cpuTime;
+
+      checkCancellation();
+
+      block.param = param;
+    }
+
+    auto i = itsTimeIndex - block.firstTimeIndex;
+
+    itsGridValues = block.values[i];
+    cropMan = block.cropMan[i];
   }
   catch (...)
   {
@@ -4201,12 +4765,11 @@ void DataStreamer::buildGridQuery(QueryServer::Query &gridQuery,
 
       if (itsReqParams.dataSource == GridContent)
       {
-        vector<string> paramParts;
-        itsQuery.parseRadonParameterName(paramIter->name(), paramParts);
+        const auto &radonParameter = itsQuery.getRadonParameter(paramIter->name());
 
-        queryParam.mForecastType = getForecastType(paramIter->name(), paramParts);
-        queryParam.mForecastNumber = getForecastNumber(paramIter->name(), paramParts);
-        queryParam.mGeometryId = getGeometryId(paramIter->name(), paramParts);
+        queryParam.mForecastType = radonParameter.forecastType;
+        queryParam.mForecastNumber = radonParameter.forecastNumber;
+        queryParam.mGeometryId = radonParameter.geometryId;
       }
       else
       {
@@ -4646,50 +5209,91 @@ void DataStreamer::regLLToGridRotatedCoords(const QueryServer::Query &gridQuery)
 {
   try
   {
-    auto coords = gridQuery.mQueryParameterList.front().mCoordinates;
+    auto const &coords = gridQuery.mQueryParameterList.front().mCoordinates;
 
     if (coords.empty())
       throw Fmi::Exception(BCP, "No coordinates to transform");
 
-    itsGridMetaData.rotLongitudes.reset(new double[coords.size()]);
-    itsGridMetaData.rotLatitudes.reset(new double[coords.size()]);
-    std::unique_ptr<int[]> pS(new int[coords.size()]);
+    auto rotLLSRS = itsResources.getGeometrySRS();
+    rotLLSRS->SetAxisMappingStrategy(OAMS_TRADITIONAL_GIS_ORDER);
+
+    // Use cached coordinates if available for the geometry (rotated latlon cs and the
+    // regular latlon coordinates)
 
-    auto rotLons = itsGridMetaData.rotLongitudes.get();
-    auto rotLon = rotLons;
-    auto rotLats = itsGridMetaData.rotLatitudes.get();
-    auto rotLat = rotLats;
-    auto pabSuccess = pS.get();
+    string geometryKey;
+    std::shared_ptr<const GridCoordinates> coordinates;
 
-    for (auto const &coord : coords)
+    if (itsCoordinateCache && itsCoordinateCache->enabled())
     {
-      *rotLon = coord.x();
-      rotLon++;
-      *rotLat = coord.y();
-      rotLat++;
+      std::size_t coordHash = coords.size();
+
+      for (auto const &coord : coords)
+      {
+        boost::hash_combine(coordHash, coord.x());
+        boost::hash_combine(coordHash, coord.y());
+      }
+
+      geometryKey = getWKT(rotLLSRS) + ";" + Fmi::to_string(coords.size()) + ";" +
+                    Fmi::to_string(coords.front().x()) + "," + Fmi::to_string(coords.front().y()) +
+                    ";" + Fmi::to_string(coordHash);
+
+      coordinates = itsCoordinateCache->find(geometryKey);
     }
 
-    auto rotLLSRS = itsResources.getGeometrySRS();
-    rotLLSRS->SetAxisMappingStrategy(OAMS_TRADITIONAL_GIS_ORDER);
+    if (!coordinates)
+    {
+      auto rotCoordinates = std::make_shared<GridCoordinates>();
 
-    OGRSpatialReference regLLSRS;
-    regLLSRS.CopyGeogCSFrom(rotLLSRS);
-    regLLSRS.SetAxisMappingStrategy(OAMS_TRADITIONAL_GIS_ORDER);
+      rotCoordinates->rotLongitudes.resize(coords.size());
+      rotCoordinates->rotLatitudes.resize(coords.size());
+      std::unique_ptr<int[]> pS(new int[coords.size()]);
 
-    OGRCoordinateTransformation *ct = itsResources.getCoordinateTransformation(&regLLSRS, rotLLSRS);
+      auto rotLons = rotCoordinates->rotLongitudes.data();
+      auto rotLon = rotLons;
+      auto rotLats = rotCoordinates->rotLatitudes.data();
+      auto rotLat = rotLats;
+      auto pabSuccess = pS.get();
 
-    int status = ct->Transform(coords.size(), rotLons, rotLats, nullptr, pabSuccess);
+      for (auto const &coord : coords)
+      {
+        *rotLon = coord.x();
+        rotLon++;
+        *rotLat = coord.y();
+        rotLat++;
+      }
 
-    if (status != 0)
-      for (size_t n = 0; (n < coords.size()); n++, pabSuccess++)
-        if (*pabSuccess == 0)
-        {
-          status = 0;
-          break;
-        }
+      OGRSpatialReference regLLSRS;
+      regLLSRS.CopyGeogCSFrom(rotLLSRS);
+      regLLSRS.SetAxisMappingStrategy(OAMS_TRADITIONAL_GIS_ORDER);
+
+      OGRCoordinateTransformation *ct =
+          itsResources.getCoordinateTransformation(&regLLSRS, rotLLSRS);
+
+      int status = ct->Transform(coords.size(), rotLons, rotLats, nullptr, pabSuccess);
+
+      if (status != 0)
+        for (size_t n = 0; (n < coords.size()); n++, pabSuccess++)
+          if (*pabSuccess == 0)
+          {
+            status = 0;
+            break;
+          }
+
+      if (!status)
+        throw Fmi::Exception(BCP, "Failed to transform regular latlon coords to rotated");
+
+      coordinates = rotCoordinates;
+
+      if (!geometryKey.empty())
+        itsCoordinateCache->insert(geometryKey, coordinates);
+    }
+
+    // The arrays are shared with the cache entry
 
-    if (!status)
-      throw Fmi::Exception(BCP, "Failed to transform regular latlon coords to rotated");
+    itsGridMetaData.rotLongitudes =
+        std::shared_ptr<const double[]>(coordinates, coordinates->rotLongitudes.data());
+    itsGridMetaData.rotLatitudes =
+        std::shared_ptr<const double[]>(coordinates, coordinates->rotLatitudes.data());
   }
   catch (...)
   {
@@ -4714,27 +5318,20 @@ QueryServer::ParameterValues_sptr DataStreamer::getValueListItem(
 
     if (itsGridIndex > 0)
     {
-      if (gridQuery.mQueryParameterList.size() > 1)
-      {
-        if (itsGridIndex >= gridQuery.mQueryParameterList.size())
-          throw Fmi::Exception(BCP, "getValueListItem: internal: parameter index out of bounds");
-
-        auto itp = gridQuery.mQueryParameterList.begin();
-        advance(itp, itsGridIndex);
+      // Use the index built for the executed query
 
-        if (itp->mValueList.size() == 0)
-          return nullptr;
+      if (&gridQuery != &itsGridQuery)
+        throw Fmi::Exception(BCP, "getValueListItem: internal: grid query is not indexed");
 
-        return itp->mValueList.front();
-      }
+      if (itsGridIndex >= itsGridValueListItems.size())
+      {
+        if (gridQuery.mQueryParameterList.size() > 1)
+          throw Fmi::Exception(BCP, "getValueListItem: internal: parameter index out of bounds");
 
-      if (itsGridIndex >= gridQuery.mQueryParameterList.begin()->mValueList.size())
         throw Fmi::Exception(BCP, "getValueListItem: internal: time index out of bounds");
+      }
 
-      auto itt = gridQuery.mQueryParameterList.begin()->mValueList.begin();
-      advance(itt, itsGridIndex);
-
-      return *itt;
+      return itsGridValueListItems[itsGridIndex];
     }
 
     if (gridQuery.mQueryParameterList.front().mValueList.size() == 0)
@@ -5041,17 +5638,13 @@ size_t DataStreamer::bufferIndex() const
         return 0;
 
       auto validTime = toTimeT(itsTimeIterator->utc_time());
-      auto forecastTime = itsGridQuery.mForecastTimeList.begin();
 
       index = (itsTimeIndex % itsReqParams.gridTimeBlockSize);
 
-      if (index >= itsGridQuery.mForecastTimeList.size())
+      if (index >= itsGridForecastTimes.size())
         throw Fmi::Exception(BCP, "bufferIndex: internal: time index out of bounds");
 
-      if (index > 0)
-        advance(forecastTime, index);
-
-      bool timeMatch = (*forecastTime == validTime);
+      bool timeMatch = (itsGridForecastTimes[index] == validTime);
 
       if ((!timeMatch) && itsGridMetaData.paramGeometries.empty())
       {
@@ -5063,13 +5656,53 @@ size_t DataStreamer::bufferIndex() const
       return (timeMatch ? index : 0);
     }
 
-    auto param = itsGridQuery.mQueryParameterList.begin();
+    auto param = itsGridParamIndexes.find(itsParamIterator->name());
 
-    for (; (param != itsGridQuery.mQueryParameterList.end()); param++, index++)
-      if (param->mParam == itsParamIterator->name())
-        return index;
+    return ((param != itsGridParamIndexes.end()) ? param->second : 0);
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
 
-    return 0;
+// ----------------------------------------------------------------------
+/*!
+ * \brief Index the executed grid query's result for constant time access
+ *        of the buffered grids
+ *
+ */
+// ----------------------------------------------------------------------
+
+void DataStreamer::indexGridQuery()
+{
+  try
+  {
+    itsGridValueListItems.clear();
+    itsGridParamIndexes.clear();
+    itsGridForecastTimes.assign(itsGridQuery.mForecastTimeList.begin(),
+                                itsGridQuery.mForecastTimeList.end());
+
+    if (itsGridQuery.mQueryParameterList.size() > 1)
+    {
+      // Parameter block; first value list item of each parameter
+
+      size_t index = 0;
+
+      for (auto const &param : itsGridQuery.mQueryParameterList)
+      {
+        itsGridParamIndexes.insert(make_pair(param.mParam, index++));
+        itsGridValueListItems.push_back(param.mValueList.empty() ? nullptr
+                                                                 : param.mValueList.front());
+      }
+    }
+    else if (itsGridQuery.mQueryParameterList.size() == 1)
+    {
+      // Time block; value list items of the parameter
+
+      const auto &valueList = itsGridQuery.mQueryParameterList.front().mValueList;
+      itsGridValueListItems.assign(valueList.begin(), valueList.end());
+    }
   }
   catch (...)
   {
@@ -5125,6 +5758,8 @@ void DataStreamer::extractGridData(string &chunk)
           exception.addParameter("Message", QueryServer::getResultString(result));
           throw exception;
         }
+
+        indexGridQuery();
       }
 
       // Unfortunately no usable status is returned by gridengine query.
@@ -7,7 +7,11 @@
 #pragma once
 
 #include "Config.h"
+#include "CoordinateCache.h"
+#include "ExtractionPool.h"
+#include "MessageIndex.h"
 #include "Query.h"
+#include "RequestCost.h"
 #include "Resources.h"
 #include "Tools.h"
 #include <engines/geonames/Engine.h>
@@ -24,6 +28,10 @@
 #include <spine/HTTP.h>
 #include <timeseries/TimeSeriesGenerator.h>
 #include <ogr_spatialref.h>
+#include <chrono>
+#include <optional>
+#include <unordered_map>
+#include <vector>
 
 namespace SmartMet
 {
@@ -61,8 +69,14 @@ class DataStreamer : public Spine::HTTP::ContentStreamer
   void setEngines(const Engine::Querydata::Engine *theQEngine,
                   const Engine::Grid::Engine *theGridEngine,
                   const Engine::Geonames::Engine *theGeoEngine);
+  void setCoordinateCache(CoordinateCache *coordinateCache)
+  {
+    itsCoordinateCache = coordinateCache;
+  }
+  void setExtractionPool(ExtractionPool *extractionPool) { itsExtractionPool = extractionPool; }
 
   const Config &getConfig() const { return itsCfg; }
+  bool isNativeQueryDataRequest() const;
   bool hasRequestedData(const Producer &producer,
                         Fmi::DateTime &oTime,
                         Fmi::DateTime &sTime,
@@ -70,6 +84,35 @@ class DataStreamer : public Spine::HTTP::ContentStreamer
 
   virtual std::string getChunk() = 0;
 
+  // Skip given number of output bytes without generating the data if possible.
+  // Returns the number of bytes skipped (0 if not supported)
+  virtual std::size_t skipBytes(std::size_t /* nBytes */) { return 0; }
+
+  // Output size if known before streaming
+  virtual std::optional<std::size_t> getOutputSize() const { return std::nullopt; }
+
+  // Size of the leading part of the output known before streaming; data within it can be
+  // skipped without generating the data (0 if not known)
+  virtual std::size_t getSkippableSize() const { return 0; }
+
+  // Index of generated message sizes for resuming deterministic output
+  virtual void setMessageIndex(MessageIndex & /* messageIndex */,
+                               const std::string & /* requestKey */)
+  {
+  }
+
+  // Estimated output size if it can be estimated before streaming
+  virtual std::optional<std::size_t> getEstimatedOutputSize() const { return getOutputSize(); }
+
+  // Cancel data extraction of all requests (on shutdown)
+  static void cancelAll();
+
+  RequestCost estimateCost() const;
+  void setAdmissionTicket(const std::shared_ptr<AdmissionControl::Ticket> &ticket)
+  {
+    itsAdmissionTicket = ticket;
+  }
+
   virtual void getDataChunk(Engine::Querydata::Q q,
                             const NFmiArea *area,
                             NFmiGrid *grid,
@@ -86,7 +129,12 @@ class DataStreamer : public Spine::HTTP::ContentStreamer
  protected:
   void createQD(const NFmiGrid &g);
   void extractData(std::string &chunk);
+  bool isCancelled() const { return itsCancelledFlag; }
   virtual void paramChanged(size_t nextParamOffset = 1) {}
+  const std::string &firstDataChunk() const { return itsDataChunk; }
+  bool canSkipGrids() const;
+  void skipGrids(std::size_t nGrids);
+  bool chunkTimeBudgetExceeded(const std::chrono::steady_clock::time_point &startTime) const;
 
   const Spine::HTTP::Request &itsRequest;
 
@@ -102,6 +150,8 @@ class DataStreamer : public Spine::HTTP::ContentStreamer
   NFmiDataMatrix<float> itsGridValues;
   unsigned int itsChunkLength;
   unsigned int itsMaxMsgChunks;
+  bool itsParallelExtraction = false;  // If set, querydata grids can be extracted in parallel
+  ExtractionPool *itsExtractionPool = nullptr;  // Worker threads shared by all requests
 
   bool itsMetaFlag = true;
   FmiLevelType itsLevelType;  // Data level type; height level data with negative levels is stored
@@ -122,6 +172,8 @@ class DataStreamer : public Spine::HTTP::ContentStreamer
   double itsDX = 0;
   double itsDY = 0;
 
+  CoordinateCache *itsCoordinateCache = nullptr;  // Computed coordinates by geometry
+
   struct Cropping
   {
     bool crop = false;     // Is cropping in use ?
@@ -151,6 +203,7 @@ class DataStreamer : public Spine::HTTP::ContentStreamer
 
   Engine::Querydata::Q itsQ;    // Q for input querydata file
   Engine::Querydata::Q itsCPQ;  // Q for in-memory querydata object containing current parameter
+  Engine::Querydata::SharedModel itsCPQModel;  // Model of itsCPQ for creating Qs for workers
   Fmi::DateTime itsOriginTime;
   Fmi::DateTime itsFirstDataTime;
   Fmi::DateTime itsLastDataTime;
@@ -167,6 +220,9 @@ class DataStreamer : public Spine::HTTP::ContentStreamer
   DataStreamer();
 
   bool resetDataSet();
+  bool cancellationRequested() const;
+  void checkCancellation();
+  bool extractGrid(std::string &chunk);
 
   void checkDataTimeStep(long timeStep = -1);
 
@@ -200,7 +256,25 @@ class DataStreamer : public Spine::HTTP::ContentStreamer
 
   std::string getGridCenterBBoxStr() const;
 
-  void cachedProjGridValues(Engine::Querydata::Q q, NFmiGrid &wantedGrid, const NFmiMetTime *mt);
+  void initLocationCache(Engine::Querydata::Q q, const NFmiGrid &wantedGrid);
+  void cachedProjGridValues(Engine::Querydata::Q q,
+                            NFmiGrid &wantedGrid,
+                            const NFmiMetTime *mt,
+                            NFmiDataMatrix<float> &values);
+  void getGridValues(Engine::Querydata::Q q,
+                     NFmiGrid *grid,
+                     int level,
+                     bool exactLevel,
+                     bool nonNativeGrid,
+                     const NFmiMetTime &mt,
+                     NFmiDataMatrix<float> &values,
+                     bool &cropMan);
+  void getGridValuesFromBlock(Engine::Querydata::Q q,
+                              NFmiGrid *grid,
+                              int level,
+                              bool exactLevel,
+                              bool nonNativeGrid,
+                              bool &cropMan);
 
   bool isLevelAvailable(Engine::Querydata::Q q, int &requestedLevel, bool &exactLevel) const;
 
@@ -228,7 +302,8 @@ class DataStreamer : public Spine::HTTP::ContentStreamer
                                         bool requestTimes = false,
                                         bool nativeTimes = false) const;
 
-  Engine::Querydata::Q getCurrentParamQ(const std::list<FmiParameterName> &currentParams) const;
+  Engine::Querydata::Q getCurrentParamQ(const std::list<FmiParameterName> &currentParams,
+                                        Engine::Querydata::SharedModel &model) const;
 
   void nextParam(Engine::Querydata::Q q);
 
@@ -259,8 +334,36 @@ class DataStreamer : public Spine::HTTP::ContentStreamer
 
   bool itsMultiFile = false;
 
+  // Admission ticket; released when all data has been extracted, extraction fails or the
+  // streamer is destroyed
+  std::shared_ptr<AdmissionControl::Ticket> itsAdmissionTicket;
+
+  // Data extraction time used so far and start time of the ongoing extraction; time spent
+  // waiting for the client to read the output is not counted
+
+  std::chrono::steady_clock::duration itsProcessingTime{0};
+  std::optional<std::chrono::steady_clock::time_point> itsExtractionStartTime;
+  bool itsCancelledFlag = false;
+  double itsExtractionCpuTime = 0;  // Cpu seconds used to extract the grids
+  std::size_t itsExtractedGrids = 0;
+
   NFmiDataMatrix<NFmiLocationCache> itsLocCache;
 
+  // Current parameter's grid values for a block of validtimes extracted in parallel
+
+  struct GridValuesBlock
+  {
+    long param = -1;  // -1 if not set
+    std::size_t levelIndex = 0;
+    std::size_t firstTimeIndex = 0;
+    std::vector<NFmiDataMatrix<float>> values;
+    std::vector<char> cropMan;  // Set if manual cropping is needed
+  };
+
+  GridValuesBlock itsGridValuesBlock;
+
+  std::size_t itsSkipGrids = 0;  // Number of grids to skip without extracting them
+
   // Grid support
   //
 
@@ -293,15 +396,15 @@ class DataStreamer : public Spine::HTTP::ContentStreamer
     }
 
     std::string producer;
-    std::string crs;                        // grid.crs/grid.original.crs
-    T::GridProjection projType;             // wkt PROJECTION or p4 EXTENSION
-    std::string projection;                 //
-    bool relativeUV;                        // QueryServer::Query grid.original.relativeUV
-    std::optional<BBoxCorners> targetBBox;  // target projection native coordinate bbox
-    double southernPoleLat;                 // wkt p4 EXTENSION o_lat_p
-    double southernPoleLon;                 // wkt p4 EXTENSION o_lon_p
-    std::unique_ptr<double> rotLongitudes;  // rotated coords for rotlat grid
-    std::unique_ptr<double> rotLatitudes;   //
+    std::string crs;                                // grid.crs/grid.original.crs
+    T::GridProjection projType;                     // wkt PROJECTION or p4 EXTENSION
+    std::string projection;                         //
+    bool relativeUV;                                // QueryServer::Query grid.original.relativeUV
+    std::optional<BBoxCorners> targetBBox;          // target projection native coordinate bbox
+    double southernPoleLat;                         // wkt p4 EXTENSION o_lat_p
+    double southernPoleLon;                         // wkt p4 EXTENSION o_lon_p
+    std::shared_ptr<const double[]> rotLongitudes;  // rotated coords for rotlat grid
+    std::shared_ptr<const double[]> rotLatitudes;   //
 
     typedef std::map<std::string, std::set<std::string>> StringMapSet;
     typedef StringMapSet OriginTimeTimes;
@@ -367,6 +470,7 @@ class DataStreamer : public Spine::HTTP::ContentStreamer
   void getGridOrigo(const QueryServer::Query &gridQuery);
   bool setDataTimes(const QueryServer::Query &gridQuery);
   bool getGridQueryInfo(const QueryServer::Query &gridQuery);
+  void indexGridQuery();
   std::size_t bufferIndex() const;
   void extractGridData(std::string &chunk);
 
@@ -376,6 +480,13 @@ class DataStreamer : public Spine::HTTP::ContentStreamer
   GridMetaData itsGridMetaData;
   QueryServer::Query itsGridQuery;
 
+  // Index of the executed grid query's result; value list items by buffer index, buffer index
+  // by parameter name (parameter block) and forecast times (time block)
+
+  std::vector<QueryServer::ParameterValues_sptr> itsGridValueListItems;
+  std::unordered_map<std::string, std::size_t> itsGridParamIndexes;
+  std::vector<time_t> itsGridForecastTimes;
+
   QueryServer::ParameterValues_sptr getValueListItem(const QueryServer::Query &gridQuery) const;
 };
 
@@ -0,0 +1,144 @@
+// ======================================================================
+/*!
+ * \brief SmartMet download service plugin; worker threads for parallel
+ *        grid extraction
+ */
+// ======================================================================
+
+#include "ExtractionPool.h"
+#include <macgyver/Exception.h>
+
+using namespace std;
+
+namespace SmartMet
+{
+namespace Plugin
+{
+namespace Download
+{
+ExtractionPool::~ExtractionPool()
+{
+  shutdown();
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Start the worker threads
+ */
+// ----------------------------------------------------------------------
+
+void ExtractionPool::init(unsigned int nThreads)
+{
+  try
+  {
+    for (unsigned int i = 0; (i < nThreads); i++)
+      itsThreads.push_back(std::thread(&ExtractionPool::work, this));
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Stop the worker threads.
+ *
+ *		Queued tasks are discarded; requests waiting for them get an
+ *		exception
+ */
+// ----------------------------------------------------------------------
+
+void ExtractionPool::shutdown()
+{
+  {
+    std::lock_guard<std::mutex> lock(itsMutex);
+
+    if (itsShutdownFlag)
+      return;
+
+    itsShutdownFlag = true;
+    itsQueue.clear();
+  }
+
+  itsCondition.notify_all();
+
+  for (auto &thread : itsThreads)
+    if (thread.joinable())
+      thread.join();
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Execute the tasks and wait for them to complete
+ */
+// ----------------------------------------------------------------------
+
+void ExtractionPool::run(std::vector<std::function<void()>> &tasks)
+{
+  try
+  {
+    std::vector<std::future<void>> results;
+
+    {
+      std::lock_guard<std::mutex> lock(itsMutex);
+
+      if (itsShutdownFlag)
+        throw Fmi::Exception(BCP, "Extraction pool has been shut down");
+
+      for (auto &task : tasks)
+      {
+        itsQueue.emplace_back(std::move(task));
+        results.push_back(itsQueue.back().get_future());
+      }
+    }
+
+    itsCondition.notify_all();
+
+    // Wait for all tasks before rethrowing, since they refer to caller's data
+
+    for (auto &result : results)
+      result.wait();
+
+    for (auto &result : results)
+      result.get();
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Worker thread; execute queued tasks
+ */
+// ----------------------------------------------------------------------
+
+void ExtractionPool::work()
+{
+  while (true)
+  {
+    std::packaged_task<void()> task;
+
+    {
+      std::unique_lock<std::mutex> lock(itsMutex);
+
+      itsCondition.wait(lock, [this]() { return (itsShutdownFlag || (!itsQueue.empty())); });
+
+      if (itsShutdownFlag)
+        return;
+
+      task = std::move(itsQueue.front());
+      itsQueue.pop_front();
+    }
+
+    // Exceptions are stored into the task's result
+
+    task();
+  }
+}
+
+}  // namespace Download
+}  // namespace Plugin
+}  // namespace SmartMet
@@ -0,0 +1,64 @@
+// ======================================================================
+/*!
+ * \brief SmartMet download service plugin; worker threads for parallel
+ *        grid extraction
+ */
+// ======================================================================
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace SmartMet
+{
+namespace Plugin
+{
+namespace Download
+{
+// ----------------------------------------------------------------------
+/*!
+ * \brief Pool of worker threads shared by all requests.
+ *
+ *        Limits the total number of threads extracting grids in
+ *        parallel; tasks of concurrent requests are queued and executed
+ *        in submission order.
+ */
+// ----------------------------------------------------------------------
+
+class ExtractionPool
+{
+ public:
+  ExtractionPool() = default;
+  ExtractionPool(const ExtractionPool &other) = delete;
+  ExtractionPool &operator=(const ExtractionPool &other) = delete;
+  ~ExtractionPool();
+
+  void init(unsigned int nThreads);
+  void shutdown();
+
+  std::size_t size() const { return itsThreads.size(); }
+
+  // Execute the tasks and wait for them to complete. Rethrows the first exception thrown by
+  // the tasks
+
+  void run(std::vector<std::function<void()>> &tasks);
+
+ private:
+  void work();
+
+  std::mutex itsMutex;
+  std::condition_variable itsCondition;
+  std::deque<std::packaged_task<void()>> itsQueue;
+  std::vector<std::thread> itsThreads;
+  bool itsShutdownFlag = false;
+};
+
+}  // namespace Download
+}  // namespace Plugin
+}  // namespace SmartMet
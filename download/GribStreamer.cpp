@@ -18,6 +18,8 @@
 #include <newbase/NFmiQueryDataUtil.h>
 #include <newbase/NFmiTimeList.h>
 #include <sys/types.h>
+#include <cmath>
+#include <cstring>
 #include <string>
 #include <unistd.h>
 
@@ -40,6 +42,10 @@ namespace {
   const string MostUnstableParcelLevel("mostUnstableParcel");
   const string HeightLayerLevel("heightAboveGroundLayer");
   const string MaxWindLevel("maxWind");
+
+  // Max number of bits per value when packing with configured precision; float precision
+  //
+  const long maxPrecisionBitsPerValue = 24;
 }
 
 namespace SmartMet
@@ -69,6 +75,13 @@ GribStreamer::GribStreamer(const Spine::HTTP::Request &req,
       throw Fmi::Exception(BCP,
                              string("Could not get handle for grib") + (itsGrib1Flag ? "1" : "2"));
 
+    // Number of bits per value restored when precision based value does not apply, unless
+    // given in the request or producer's named settings
+
+    itsSampleBitsPerValue = get_long(itsGribHandle, "bitsPerValue");
+    itsDefaultBitsPerValue =
+        ((reqParams.bitsPerValue >= 0) ? reqParams.bitsPerValue : itsSampleBitsPerValue);
+
     // Set tables version for grib2
 
     if (reqParams.grib2TablesVersion > 0)
@@ -85,6 +98,19 @@ GribStreamer::~GribStreamer()
 {
   if (itsGribHandle)
     grib_handle_delete(itsGribHandle);
+
+  try
+  {
+    // Store the sizes of the generated messages for resuming the download
+
+    if (itsMessageIndex && itsMessageSizes)
+      itsMessageIndex->insert(itsRequestKey, itsMessageSizes);
+  }
+  catch (...)
+  {
+    Fmi::Exception exception(BCP, "Failed to store grib message sizes", nullptr);
+    std::cerr << exception.getStackTrace();
+  }
 }
 
 // ----------------------------------------------------------------------
@@ -775,12 +801,13 @@ void GribStreamer::setLambertAzimuthalEqualAreaGeometryToGrib() const
 
 // ----------------------------------------------------------------------
 /*!
- * \brief Set grib named configuration settings.
+ * \brief Resolve grib named configuration settings for the producer.
  *
+ *		The settings are set to grib with level and parameter keys
  */
 // ----------------------------------------------------------------------
 
-void GribStreamer::setNamedSettingsToGrib() const
+void GribStreamer::setNamedSettingsToGrib()
 {
   try
   {
@@ -790,13 +817,23 @@ void GribStreamer::setNamedSettingsToGrib() const
     {
       // Take producer name from radon parameter name T-K:MEPS:1093:6,...
 
-      vector<string> paramParts;
-      itsQuery.parseRadonParameterName(itsParamIterator->name(), paramParts);
-      producer = paramParts[1];
+      producer = itsQuery.getRadonParameter(itsParamIterator->name()).producer;
     }
     else
       producer = itsReqParams.producer;
 
+    // The settings are constant for the producer; resolve them when the producer changes
+
+    if (itsNamedSettingsProducer && (*itsNamedSettingsProducer == producer))
+      return;
+
+    itsNamedSettingsProducer = producer;
+    itsNamedSettings.clear();
+    itsAppliedLevelAndParameterKeys = nullptr;
+
+    if (itsReqParams.bitsPerValue < 0)
+      itsDefaultBitsPerValue = itsSampleBitsPerValue;
+
     const Producer &pr = itsCfg.getProducer(producer);
     auto setBeg = pr.namedSettingsBegin();
     auto setEnd = pr.namedSettingsEnd();
@@ -805,10 +842,12 @@ void GribStreamer::setNamedSettingsToGrib() const
 
     for (auto it = setBeg; (it != setEnd); it++)
     {
-      gset(itsGribHandle, (it->first).c_str(), it->second);
+      itsNamedSettings.add((it->first).c_str(), it->second);
 
       if (it->first == centre)
         hasCentre = true;
+      else if ((it->first == "bitsPerValue") && (itsReqParams.bitsPerValue < 0))
+        itsDefaultBitsPerValue = it->second;
     }
 
     // Use default procuder's centre by default
@@ -819,7 +858,7 @@ void GribStreamer::setNamedSettingsToGrib() const
       const auto dit = dpr.namedSettings.find(centre);
 
       if (dit != dpr.namedSettingsEnd())
-        gset(itsGribHandle, (dit->first).c_str(), dit->second);
+        itsNamedSettings.add((dit->first).c_str(), dit->second);
     }
   }
   catch (...)
@@ -890,11 +929,6 @@ void GribStreamer::setGeometryToGrib(const NFmiArea *area, bool relative_uv)
       resolAndCompFlags &= ~(1 << 3);
 
     gset(itsGribHandle, "resolutionAndComponentFlags", resolAndCompFlags);
-
-    // Bitmap to flag missing values
-
-    gset(itsGribHandle, "bitmapPresent", 1);
-    gset(itsGribHandle, "missingValue", gribMissingValue);
   }
   catch (...)
   {
@@ -953,11 +987,35 @@ void GribStreamer::setGridGeometryToGrib(const QueryServer::Query &gridQuery)
       resolAndCompFlags &= ~(1 << 3);
 
     gset(itsGribHandle, "resolutionAndComponentFlags", resolAndCompFlags);
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Set bitmap to flag missing values.
+ *
+ *		Missing values are excluded from packing by the bitmap; the bitmap
+ *		is omitted for grids having no missing values
+ */
+// ----------------------------------------------------------------------
 
-    // Bitmap to flag missing values
+void GribStreamer::setBitmapToGrib(bool hasMissingValues)
+{
+  try
+  {
+    if (itsBitmapPresent && (*itsBitmapPresent == hasMissingValues))
+      return;
+
+    gset(itsGribHandle, "bitmapPresent", hasMissingValues ? 1 : 0);
+
+    if (hasMissingValues)
+      gset(itsGribHandle, "missingValue", gribMissingValue);
 
-    gset(itsGribHandle, "bitmapPresent", 1);
-    gset(itsGribHandle, "missingValue", gribMissingValue);
+    itsBitmapPresent = hasMissingValues;
   }
   catch (...)
   {
@@ -1049,11 +1107,17 @@ string GribStreamer::gribLevelTypeAndLevel(bool gridContent, FmiLevelType levelT
       BCP, "Unrecognized level type " + boost::lexical_cast<string>(levelType));
 }
 
-void GribStreamer::setLevelAndParameterToGrib(int level,
-                                              const NFmiParam &theParam,
-                                              const string &paramName,
-                                              const ParamChangeTable &pTable,
-                                              std::size_t &paramIdx)
+// ----------------------------------------------------------------------
+/*!
+ * \brief Resolve level and parameter keys and values for grib buffer
+ */
+// ----------------------------------------------------------------------
+
+GribKeyValues GribStreamer::getLevelAndParameterKeys(int level,
+                                                     const NFmiParam &theParam,
+                                                     const string &paramName,
+                                                     const ParamChangeTable &pTable,
+                                                     std::size_t &paramIdx) const
 {
   // Get parameter id, and configured level type and value for surface data.
   //
@@ -1069,9 +1133,9 @@ void GribStreamer::setLevelAndParameterToGrib(int level,
     T::ForecastType forecastType = 0;
     T::ForecastNumber forecastNumber = 0;
     std::optional<long> templateNumber;
-    bool gridContent = (itsReqParams.dataSource == GridContent), foundParam = false;
-    std::size_t i, j = pTable.size();
-    auto paramIndexIter = paramConfigIndexes.end();
+    bool gridContent = (itsReqParams.dataSource == GridContent);
+    std::size_t i = pTable.size(), j = pTable.size();
+    GribKeyValues keyValues;
 
     paramIdx = pTable.size();
 
@@ -1079,81 +1143,60 @@ void GribStreamer::setLevelAndParameterToGrib(int level,
     {
       // Take parameter name and level type from radon parameter name T-K:MEPS:1093:6,...
 
-      vector<string> paramParts;
-      itsQuery.parseRadonParameterName(paramName, paramParts);
-      radonParam = paramParts[0];
-      radonProducer = paramParts[1];
-
-      levelType = FmiLevelType(getParamLevelId(paramName, paramParts));
-      forecastType = getForecastType(paramName, paramParts);
-      forecastNumber = getForecastNumber(paramName, paramParts);
-
-      // Search map for the param and producer and return the parameter config index
-      // if found and the radon parameter does not change (looping timesteps).
-      //
-      // TODO: Use parameter config index map for querydata and gridmapping queries too ?
-
-      paramIndexIter = paramConfigIndexes.find(radonParam);
+      const auto &radonParameter = itsQuery.getRadonParameter(paramName);
+      radonParam = radonParameter.name;
+      radonProducer = radonParameter.producer;
 
-      if (paramIndexIter != paramConfigIndexes.end())
-      {
-        auto it = paramIndexIter->second.find(radonProducer);
-        foundParam = (it != paramIndexIter->second.end());
-
-        if (foundParam)
-        {
-          paramIdx = it->second;
-
-          if (paramName == itsPreviousParam)
-            return;
-        }
-      }
-
-      itsPreviousParam = paramName;
+      levelType = FmiLevelType(radonParameter.levelTypeId);
+      forecastType = radonParameter.forecastType;
+      forecastNumber = radonParameter.forecastNumber;
     }
     else
       levelType = itsLevelType;
 
-    if (!foundParam)
-    {
-      for (i = 0; i < pTable.size(); ++i)
-        if (! gridContent)
-        {
-          if (usedParId == pTable[i].itsWantedParam.GetIdent())
-          {
-            // Preferring entry with level for surface data and without level for pressure and
-            // hybrid data.
-            // If preferred entry does not exist, taking the parameter id from the first entry
-            // for the parameter.
-            //
-            cfgLevel = pTable[i].itsLevel;
+    const auto &indexes = (gridContent ? pTable.getIndexesByRadonName(radonParam)
+                                       : pTable.getIndexesByParamId((unsigned long) usedParId));
 
-            if ((isSurfaceLevel(levelType) && cfgLevel) || (!(isSurfaceLevel(levelType) || cfgLevel)))
-              break;
+    for (auto idx : indexes)
+    {
+      if (! gridContent)
+      {
+        // Preferring entry with level for surface data and without level for pressure and
+        // hybrid data.
+        // If preferred entry does not exist, taking the parameter id from the first entry
+        // for the parameter.
+        //
+        cfgLevel = pTable[idx].itsLevel;
 
-            if (j == pTable.size())
-              j = i;
-          }
+        if ((isSurfaceLevel(levelType) && cfgLevel) || (!(isSurfaceLevel(levelType) || cfgLevel)))
+        {
+          i = idx;
+          break;
         }
-        else if (pTable[i].itsRadonName == radonParam)
+
+        if (j == pTable.size())
+          j = idx;
+      }
+      else
+      {
+        if (!
+            (
+             (itsGrib1Flag && pTable[idx].itsGrib1Param) ||
+             ((!itsGrib1Flag) && pTable[idx].itsGrib2Param)
+            )
+           )
+          continue;
+
+        if (pTable[idx].itsRadonProducer == radonProducer)
         {
-          if (!
-              (
-               (itsGrib1Flag && pTable[i].itsGrib1Param) ||
-               ((!itsGrib1Flag) && pTable[i].itsGrib2Param)
-              )
-             )
-            continue;
-
-          if (pTable[i].itsRadonProducer == radonProducer)
-            break;
-
-          if ((j == pTable.size()) && pTable[i].itsRadonProducer.empty())
-            j = i;
+          i = idx;
+          break;
         }
+
+        if ((j == pTable.size()) && pTable[idx].itsRadonProducer.empty())
+          j = idx;
+      }
     }
-    else
-      i = paramIdx;
 
     if (i >= pTable.size())
     {
@@ -1169,14 +1212,6 @@ void GribStreamer::setLevelAndParameterToGrib(int level,
     {
       if (! gridContent)
         cfgLevel = pTable[i].itsLevel;
-      else if (!foundParam)
-      {
-        if (paramIndexIter == paramConfigIndexes.end())
-          paramIndexIter = paramConfigIndexes.insert(
-              make_pair(radonParam, ParamConfigProducerIndexes())).first;
-
-        paramIndexIter->second.insert(make_pair(radonProducer, paramIdx));
-      }
 
       usedParId = pTable[i].itsOriginalParamId;
       centre = pTable[i].itsCentre;
@@ -1186,7 +1221,7 @@ void GribStreamer::setLevelAndParameterToGrib(int level,
     levelTypeStr = gribLevelTypeAndLevel(gridContent, levelType, cfgLevel, level);
 
     if (!centre.empty())
-      gset(itsGribHandle, "centre", centre);
+      keyValues.add("centre", centre);
 
     // Cannot set template number 0 unless stepType has been set
     //
@@ -1199,7 +1234,7 @@ void GribStreamer::setLevelAndParameterToGrib(int level,
     // logic does not work for all parameters though; the correct template number must be set to
     // configuration when needed.
 
-    gset(itsGribHandle, "stepType", "instant");
+    keyValues.add("stepType", "instant");
 
     if (!itsGrib1Flag)
     {
@@ -1209,10 +1244,10 @@ void GribStreamer::setLevelAndParameterToGrib(int level,
         templateNumber = (ensemble ? 1 : 0);
 
       if (templateNumber && (gridContent || (*templateNumber != 0)))
-        gset(itsGribHandle, "productDefinitionTemplateNumber", *templateNumber);
+        keyValues.add("productDefinitionTemplateNumber", *templateNumber);
 
       if (ensemble)
-        gset(itsGribHandle, "perturbationNumber", forecastNumber);
+        keyValues.add("perturbationNumber", (long) forecastNumber);
     }
 
     auto const &gribParam = (itsGrib1Flag ? pTable[i].itsGrib1Param : pTable[i].itsGrib2Param);
@@ -1222,22 +1257,79 @@ void GribStreamer::setLevelAndParameterToGrib(int level,
       if (itsGrib1Flag)
       {
         if (gribParam->itsTable2Version)
-          gset(itsGribHandle, "table2Version", *(gribParam->itsTable2Version));
+          keyValues.add("table2Version", *(gribParam->itsTable2Version));
 
-        gset(itsGribHandle, "indicatorOfParameter", *(gribParam->itsParamNumber));
+        keyValues.add("indicatorOfParameter", *(gribParam->itsParamNumber));
       }
       else
       {
-        gset(itsGribHandle, "discipline", *(gribParam->itsDiscipline));
-        gset(itsGribHandle, "parameterCategory", *(gribParam->itsCategory));
-        gset(itsGribHandle, "parameterNumber", *(gribParam->itsParamNumber));
+        keyValues.add("discipline", *(gribParam->itsDiscipline));
+        keyValues.add("parameterCategory", *(gribParam->itsCategory));
+        keyValues.add("parameterNumber", *(gribParam->itsParamNumber));
       }
     }
     else
-      gset(itsGribHandle, "paramId", usedParId);
+      keyValues.add("paramId", usedParId);
+
+    keyValues.add("typeOfLevel", levelTypeStr);
+    keyValues.add("level", boost::numeric_cast<long>(abs(level)));
 
-    gset(itsGribHandle, "typeOfLevel", levelTypeStr);
-    gset(itsGribHandle, "level", boost::numeric_cast<long>(abs(level)));
+    return keyValues;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Set level and parameter data into grib buffer.
+ *
+ *		The keys are resolved once for each parameter and level and they
+ *		are set only when parameter or level changes (not when looping
+ *		timesteps). The keys are set in full since setting e.g. template
+ *		number resets other keys
+ */
+// ----------------------------------------------------------------------
+
+void GribStreamer::setLevelAndParameterToGrib(int level,
+                                              const NFmiParam &theParam,
+                                              const string &paramName,
+                                              const ParamChangeTable &pTable,
+                                              std::size_t &paramIdx)
+{
+  try
+  {
+    string cacheKey =
+        ((itsReqParams.dataSource == GridContent)
+             ? paramName
+             : (Fmi::to_string(theParam.GetIdent()) + ":" + Fmi::to_string(int(itsLevelType)))) +
+        "/" + Fmi::to_string(level);
+
+    auto it = itsLevelAndParameterKeys.find(cacheKey);
+
+    if (it == itsLevelAndParameterKeys.end())
+    {
+      LevelAndParameterKeys keys;
+      keys.keyValues = getLevelAndParameterKeys(level, theParam, paramName, pTable, keys.paramIdx);
+
+      it = itsLevelAndParameterKeys.insert(make_pair(cacheKey, keys)).first;
+    }
+
+    auto const &keyValues = it->second.keyValues;
+    paramIdx = it->second.paramIdx;
+
+    // Named settings are set before the keys, since the keys of the previous parameter may have
+    // overwritten them. Bitmap is set again too in case a named setting changed it
+
+    if (itsAppliedLevelAndParameterKeys != &keyValues)
+    {
+      itsNamedSettings.set(itsGribHandle);
+      keyValues.set(itsGribHandle);
+      itsAppliedLevelAndParameterKeys = &keyValues;
+      itsBitmapPresent.reset();
+    }
   }
   catch (...)
   {
@@ -1281,6 +1373,7 @@ void GribStreamer::setStepToGrib(const ParamChangeTable &pTable,
     bool hasParamConfig = (paramIdx < pTable.size());
     bool hasStepType = (hasParamConfig && (!pTable[paramIdx].itsStepType.empty()));
     std::optional<long> indicatorOfTimeRange, typeOfStatisticalProcessing;
+    GribKeyValues keyValues;
 
     if (hasParamConfig && (!hasStepType))
     {
@@ -1428,12 +1521,12 @@ void GribStreamer::setStepToGrib(const ParamChangeTable &pTable,
       if (pTable[paramIdx].itsStepType.empty())
       {
         if (itsGrib1Flag)
-          gset(itsGribHandle, "indicatorOfTimeRange", *indicatorOfTimeRange);
+          keyValues.add("indicatorOfTimeRange", *indicatorOfTimeRange);
         else
-          gset(itsGribHandle, "typeOfStatisticalProcessing", *typeOfStatisticalProcessing);
+          keyValues.add("typeOfStatisticalProcessing", *typeOfStatisticalProcessing);
       }
       else
-        gset(itsGribHandle, "stepType", pTable[paramIdx].itsStepType);
+        keyValues.add("stepType", pTable[paramIdx].itsStepType);
     }
 
     if (setOriginTime)
@@ -1444,15 +1537,17 @@ void GribStreamer::setStepToGrib(const ParamChangeTable &pTable,
       long dateLong = d.year() * 10000 + d.month() * 100 + d.day();
       long timeLong = t.hours() * 100 + t.minutes();
 
-      gset(itsGribHandle, "date", dateLong);
-      gset(itsGribHandle, "time", timeLong);
+      keyValues.add("date", dateLong);
+      keyValues.add("time", timeLong);
     }
 
     // Set time step and unit
 
-    gset(itsGribHandle, "stepUnits", stepUnits);
-    gset(itsGribHandle, "startStep", startStep);
-    gset(itsGribHandle, "endStep", endStep);
+    keyValues.add("stepUnits", stepUnits);
+    keyValues.add("startStep", startStep);
+    keyValues.add("endStep", endStep);
+
+    keyValues.set(itsGribHandle);
   }
   catch (...)
   {
@@ -1561,6 +1656,7 @@ void GribStreamer::addValuesToGrib(Engine::Querydata::Q q,
     std::size_t xStep = (itsReqParams.gridStepXY ? (*(itsReqParams.gridStepXY))[0].first : 1),
            yStep = (itsReqParams.gridStepXY ? (*(itsReqParams.gridStepXY))[0].second : 1), x, y;
     int i = 0;
+    bool hasMissingValues = false;
 
     for (y = y0; (y < yN); y += yStep)
       for (x = x0; (x < xN); x += xStep, i++)
@@ -1570,16 +1666,23 @@ void GribStreamer::addValuesToGrib(Engine::Querydata::Q q,
         if (value != kFloatMissing)
           itsValueArray[i] = (value + offset) / scale;
         else
+        {
           itsValueArray[i] = gribMissingValue;
+          hasMissingValues = true;
+        }
       }
 
-    grib_set_double_array(itsGribHandle, "values", &itsValueArray[0], itsValueArray.size());
+    setBitmapToGrib(hasMissingValues);
+
+    gset(itsGribHandle, "values", itsValueArray);
 
     // At least with older eccodes (2.27.1) it seems number of bits and packing type needs
     // to be set after values is set
 
     if (itsReqParams.bitsPerValue >= 0)
       gset(itsGribHandle, "bitsPerValue", itsReqParams.bitsPerValue);
+    else
+      setPrecisionToGrib(pTable, paramIdx);
 
     if (!itsReqParams.packing.empty())
       gset(itsGribHandle, "packingType", itsReqParams.packing);
@@ -1590,6 +1693,133 @@ void GribStreamer::addValuesToGrib(Engine::Querydata::Q q,
   }
 }
 
+// ----------------------------------------------------------------------
+/*!
+ * \brief Set number of bits per value based on parameter's configured
+ *		 precision and the value range of the grid.
+ *
+ *		The number of bits is selected so that the packing step does not
+ *		exceed the precision. eccodes uses binary scaling, rounding the
+ *		scale up to power of 2; the step for n bits is thus
+ *		2^ceil(log2(range / (2^n - 1))).
+ *
+ *		If precision is not configured for the parameter or the grid has
+ *		no values, the default number of bits is restored since the grib
+ *		handle is shared by all messages.
+ *
+ *		If the precision can not be achieved with the max number of bits,
+ *		the max is used and an error is logged once per parameter.
+ *		Decimal scaling would not help; with a fixed number of bits the
+ *		step is still range / (2^n - 1), only rounded differently
+ */
+// ----------------------------------------------------------------------
+
+void GribStreamer::setPrecisionToGrib(const ParamChangeTable &pTable, std::size_t paramIdx)
+{
+  try
+  {
+    if ((paramIdx >= pTable.size()) || (!pTable[paramIdx].itsPrecision))
+    {
+      resetBitsPerValue();
+      return;
+    }
+
+    GribValue minValue = 0, maxValue = 0;
+    bool hasValues = false;
+
+    for (auto value : itsValueArray)
+    {
+      if (value == gribMissingValue)
+        continue;
+
+      if (!hasValues)
+      {
+        minValue = maxValue = value;
+        hasValues = true;
+      }
+      else if (value < minValue)
+        minValue = value;
+      else if (value > maxValue)
+        maxValue = value;
+    }
+
+    if (!hasValues)
+    {
+      resetBitsPerValue();
+      return;
+    }
+
+    double range = maxValue - minValue;
+    double precision = *(pTable[paramIdx].itsPrecision);
+    double step = 0;
+    long bitsPerValue = 1;
+
+    if (range > 0)
+      for (; (bitsPerValue <= maxPrecisionBitsPerValue); bitsPerValue++)
+      {
+        step = pow(2.0, ceil(log2(range / (pow(2.0, bitsPerValue) - 1))));
+
+        if (step <= precision)
+          break;
+      }
+
+    if (bitsPerValue > maxPrecisionBitsPerValue)
+    {
+      bitsPerValue = maxPrecisionBitsPerValue;
+
+      if (itsPrecisionLimitedParams.insert(paramIdx).second)
+      {
+        auto const &config = pTable[paramIdx];
+
+        Fmi::Exception(BCP, "Configured precision can not be achieved, using max bits per value")
+            .addParameter("URI", itsRequest.getURI())
+            .addParameter("Parameter",
+                          (!config.itsRadonName.empty())
+                              ? config.itsRadonName
+                              : Fmi::to_string(config.itsWantedParam.GetIdent()))
+            .addParameter("Precision", Fmi::to_string(precision))
+            .addParameter("Value range", Fmi::to_string(range))
+            .addParameter("Bits per value", Fmi::to_string(bitsPerValue))
+            .addParameter("Step", Fmi::to_string(step))
+            .printError();
+      }
+    }
+
+    gset(itsGribHandle, "bitsPerValue", bitsPerValue);
+    itsPrecisionBitsPerValue = true;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Restore default number of bits per value if precision based
+ *		 value was set for previous message.
+ *
+ *		The default is producer's configured bitsPerValue or the sample's
+ *		value
+ */
+// ----------------------------------------------------------------------
+
+void GribStreamer::resetBitsPerValue()
+{
+  try
+  {
+    if (!itsPrecisionBitsPerValue)
+      return;
+
+    gset(itsGribHandle, "bitsPerValue", itsDefaultBitsPerValue);
+    itsPrecisionBitsPerValue = false;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
 // ----------------------------------------------------------------------
 /*!
  * \brief Copy grid data (one level/param/time grid) into grib buffer
@@ -1668,6 +1898,7 @@ void GribStreamer::addGridValuesToGrib(const QueryServer::Query &gridQuery,
     std::size_t xStep = (itsReqParams.gridStepXY ? (*(itsReqParams.gridStepXY))[0].first : 1),
            yStep = (itsReqParams.gridStepXY ? (*(itsReqParams.gridStepXY))[0].second : 1), x, y;
     int i = 0;
+    bool hasMissingValues = false;
 
     const auto vVec = &(getValueListItem(gridQuery)->mValueVector);
 
@@ -1682,7 +1913,14 @@ void GribStreamer::addGridValuesToGrib(const QueryServer::Query &gridQuery,
         for (x = x0; (x < xN); x += xStep, j += xStep, i++)
         {
           float value = (*vVec)[j];
-          itsValueArray[i] = ((value != ParamValueMissing) ? value : gribMissingValue);
+
+          if (value != ParamValueMissing)
+            itsValueArray[i] = value;
+          else
+          {
+            itsValueArray[i] = gribMissingValue;
+            hasMissingValues = true;
+          }
         }
       }
     }
@@ -1699,18 +1937,25 @@ void GribStreamer::addGridValuesToGrib(const QueryServer::Query &gridQuery,
           if (value != ParamValueMissing)
             itsValueArray[i] = (value + offset) / scale;
           else
+          {
             itsValueArray[i] = gribMissingValue;
+            hasMissingValues = true;
+          }
         }
       }
     }
 
-    grib_set_double_array(itsGribHandle, "values", &itsValueArray[0], itsValueArray.size());
+    setBitmapToGrib(hasMissingValues);
+
+    gset(itsGribHandle, "values", itsValueArray);
 
     // At least with older eccodes (2.27.1) it seems number of bits and packing type needs
     // to be set after values is set
 
     if (itsReqParams.bitsPerValue >= 0)
       gset(itsGribHandle, "bitsPerValue", itsReqParams.bitsPerValue);
+    else
+      setPrecisionToGrib(pTable, paramIdx);
 
     if (!itsReqParams.packing.empty())
       gset(itsGribHandle, "packingType", itsReqParams.packing);
@@ -1802,6 +2047,387 @@ string GribStreamer::getGridGribMessage(const QueryServer::Query &gridQuery,
   }
 }
 
+// ----------------------------------------------------------------------
+/*!
+ * \brief Check if grid content is requested as is (native geometry, no
+ *        packing settings, and output edition and grib2 tables version
+ *        matching the source messages), and if so, collect the source
+ *        messages' file locations to return the messages unchanged.
+ *
+ *        Must be called after hasRequestedData(). Returns false if any
+ *        transformation is needed or if any of the messages is not locally
+ *        accessible; the data is then extracted and encoded normally.
+ */
+// ----------------------------------------------------------------------
+
+bool GribStreamer::setGridContentPassThrough(const Engine::Grid::Engine *gridEngine)
+{
+  try
+  {
+    if ((itsReqParams.dataSource != GridContent) || (!gridEngine))
+      return false;
+
+    // Note: there is no unit conversion for radon parameters
+
+    if ((!itsReqParams.projection.empty()) || (!itsReqParams.geometryId.empty()) ||
+        (!itsReqParams.bbox.empty()) || (!itsReqParams.gridCenter.empty()) ||
+        (!itsReqParams.gridSize.empty()) || (!itsReqParams.gridResolution.empty()) ||
+        (!itsReqParams.gridStep.empty()) || (!itsReqParams.packing.empty()) ||
+        (itsReqParams.bitsPerValue >= 0) || (itsReqParams.gridParamBlockSize > 0))
+      return false;
+
+    set<string> dataTimes;
+
+    for (auto const &dataTime : itsDataTimes)
+      dataTimes.insert(Fmi::to_iso_string(dataTime.utc_time()));
+
+    auto cS = gridEngine->getContentServer_sptr();
+    auto const &paramContents = itsQuery.getParameterContents();
+    map<T::FileId, string> fileNames;
+    list<PassThroughMessage> messages;
+    auto fileType = (itsGrib1Flag ? T::FileTypeValue::Grib1 : T::FileTypeValue::Grib2);
+
+    for (auto const &param : itsDataParams)
+    {
+      if (itsQuery.isFunctionParameter(param.name()))
+        return false;
+
+      auto paramContent = paramContents.find(param.name());
+
+      if (paramContent == paramContents.end())
+        continue;
+
+      // Messages are returned in validtime order
+
+      map<string, const T::ContentInfo *> timeContents;
+      auto const &contentInfoList = paramContent->second;
+
+      for (size_t idx = 0; (idx < contentInfoList.getLength()); idx++)
+      {
+        auto contentInfo = contentInfoList.getContentInfoByIndex(idx);
+        string forecastTime = contentInfo->getForecastTime();
+
+        if (dataTimes.find(forecastTime) == dataTimes.end())
+          continue;
+
+        if (!timeContents.insert(make_pair(forecastTime, contentInfo)).second)
+          return false;
+      }
+
+      for (auto const &timeContent : timeContents)
+      {
+        auto contentInfo = timeContent.second;
+
+        if (contentInfo->mFileType != fileType)
+          return false;
+
+        auto fileName = fileNames.find(contentInfo->mFileId);
+
+        if (fileName == fileNames.end())
+        {
+          T::FileInfo fileInfo;
+
+          if (cS->getFileInfoById(0, contentInfo->mFileId, fileInfo) != ContentServer::Result::OK)
+            return false;
+
+          fileName = fileNames.insert(make_pair(contentInfo->mFileId, fileInfo.mName)).first;
+        }
+
+        messages.push_back(PassThroughMessage{
+            fileName->second, contentInfo->mFilePosition, contentInfo->mMessageSize});
+      }
+    }
+
+    if (messages.empty())
+      return false;
+
+    // Check the messages are accessible and grib2 messages' tables version (octet 10 of
+    // section 1, following the 16 byte section 0) matches the tables version set to the output
+    // (requested or the default) if any. Each file is opened once
+
+    map<string, list<unsigned long long>> filePositions;
+
+    for (auto const &message : messages)
+      filePositions[message.fileName].push_back(message.filePosition);
+
+    for (auto const &file : filePositions)
+    {
+      ifstream in(file.first, ios::binary | ios::in);
+
+      if (!in)
+        return false;
+
+      for (auto filePosition : file.second)
+      {
+        unsigned char header[26];
+
+        if ((!in.seekg(filePosition)) ||
+            (!in.read(reinterpret_cast<char *>(header), sizeof(header))) ||
+            (memcmp(header, "GRIB", 4) != 0) ||
+            ((itsReqParams.grib2TablesVersion > 0) &&
+             (header[25] != itsReqParams.grib2TablesVersion)))
+          return false;
+      }
+    }
+
+    itsPassThroughMessages = std::move(messages);
+    itsPassThroughFlag = true;
+
+    return true;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Set index of generated message sizes for deterministic output
+ *
+ *		Indexed sizes are not used if the size of the first message
+ *		(loaded at initialization) does not match
+ */
+// ----------------------------------------------------------------------
+
+void GribStreamer::setMessageIndex(MessageIndex &messageIndex, const std::string &requestKey)
+{
+  try
+  {
+    if (itsPassThroughFlag || (!messageIndex.enabled()) || firstDataChunk().empty())
+      return;
+
+    itsMessageIndex = &messageIndex;
+    itsRequestKey = requestKey;
+
+    itsIndexedSizes = messageIndex.find(requestKey);
+
+    if (itsIndexedSizes && (itsIndexedSizes->sizes.front() != firstDataChunk().size()))
+      itsIndexedSizes.reset();
+
+    itsMessageSizes = std::make_shared<MessageSizes>();
+    addMessageSize(firstDataChunk());
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Store the size of generated message
+ */
+// ----------------------------------------------------------------------
+
+void GribStreamer::addMessageSize(const std::string &message)
+{
+  if (itsMessageSizes && (!message.empty()))
+    itsMessageSizes->sizes.push_back(message.size());
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Skip whole grib messages fitting into given number of bytes.
+ *
+ *		Source grib messages are skipped when returning them as is.
+ *		Generated messages are skipped by their indexed sizes if known
+ *		(e.g. resuming an earlier download of the same output)
+ */
+// ----------------------------------------------------------------------
+
+std::size_t GribStreamer::skipBytes(std::size_t nBytes)
+{
+  try
+  {
+    if (!itsPassThroughFlag)
+    {
+      if ((!itsIndexedSizes) || (!canSkipGrids()))
+        return 0;
+
+      std::size_t skipped = 0, nMessages = 0;
+
+      for (auto size : itsIndexedSizes->sizes)
+      {
+        if ((skipped + size) > nBytes)
+          break;
+
+        skipped += size;
+        nMessages++;
+      }
+
+      // The sizes of the following messages are not known by this request
+
+      if (nMessages > 0)
+        itsMessageSizes.reset();
+
+      skipGrids(nMessages);
+
+      return skipped;
+    }
+
+    std::size_t skipped = 0;
+
+    while ((!itsPassThroughMessages.empty()) &&
+           ((skipped + itsPassThroughMessages.front().messageSize) <= nBytes))
+    {
+      skipped += itsPassThroughMessages.front().messageSize;
+      itsPassThroughMessages.pop_front();
+    }
+
+    return skipped;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Return output size if known (when returning source grib messages,
+ *        or the sizes of all generated messages are indexed)
+ *
+ */
+// ----------------------------------------------------------------------
+
+std::optional<std::size_t> GribStreamer::getOutputSize() const
+{
+  if (!itsPassThroughFlag)
+  {
+    if (itsIndexedSizes && itsIndexedSizes->complete)
+      return itsIndexedSizes->outputSize();
+
+    return std::nullopt;
+  }
+
+  std::size_t outputSize = 0;
+
+  for (auto const &message : itsPassThroughMessages)
+    outputSize += message.messageSize;
+
+  return outputSize;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Return the size of the leading messages which can be skipped
+ *        without generating them (source grib messages, or generated
+ *        messages whose sizes are indexed)
+ *
+ */
+// ----------------------------------------------------------------------
+
+std::size_t GribStreamer::getSkippableSize() const
+{
+  try
+  {
+    if (itsPassThroughFlag)
+      return *getOutputSize();
+
+    if (itsIndexedSizes && canSkipGrids())
+      return itsIndexedSizes->outputSize();
+
+    return 0;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Return estimated output size.
+ *
+ *		The size of the first message (loaded at initialization) is used for
+ *		all messages. The estimate is not exact, since the size of the data
+ *		section depends on the data (missing values are not stored and
+ *		constant fields are stored without values), and the size of the
+ *		product definition section depends on parameter and level
+ *
+ */
+// ----------------------------------------------------------------------
+
+std::optional<std::size_t> GribStreamer::getEstimatedOutputSize() const
+{
+  try
+  {
+    auto outputSize = getOutputSize();
+
+    if (outputSize || firstDataChunk().empty())
+      return outputSize;
+
+    // With grid content data each parameter has a single level
+
+    std::size_t nGrids = itsDataParams.size() * itsDataTimes.size();
+
+    if (itsReqParams.dataSource != GridContent)
+      nGrids *= itsDataLevels.size();
+
+    return nGrids * firstDataChunk().size();
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Get next chunk of source grib messages
+ *
+ */
+// ----------------------------------------------------------------------
+
+std::string GribStreamer::getPassThroughChunk()
+{
+  try
+  {
+    string chunk;
+    std::size_t nChunks = 0;
+
+    while ((!itsPassThroughMessages.empty()) && (nChunks < itsMaxMsgChunks) &&
+           (chunk.length() < itsChunkLength))
+    {
+      auto const &message = itsPassThroughMessages.front();
+
+      if ((!itsPassThroughStream.is_open()) || (message.fileName != itsPassThroughFileName))
+      {
+        itsPassThroughStream.close();
+        itsPassThroughStream.open(message.fileName, ios::binary | ios::in);
+        itsPassThroughFileName = message.fileName;
+      }
+
+      auto offset = chunk.length();
+      chunk.resize(offset + message.messageSize);
+
+      if ((!itsPassThroughStream.seekg(message.filePosition)) ||
+          (!itsPassThroughStream.read(&chunk[offset], message.messageSize)))
+        throw Fmi::Exception(BCP, "Error reading grib message")
+            .addParameter("File", message.fileName)
+            .addParameter("Position", Fmi::to_string(message.filePosition));
+
+      itsPassThroughMessages.pop_front();
+      nChunks++;
+    }
+
+    if (itsPassThroughMessages.empty())
+    {
+      itsPassThroughStream.close();
+      itsDoneFlag = true;
+
+      setStatus(ContentStreamer::StreamerStatus::EXIT_OK);
+    }
+
+    return chunk;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
 // ----------------------------------------------------------------------
 /*!
  * \brief Get next chunk of data. Called from SmartMet server code
@@ -1815,9 +2441,13 @@ std::string GribStreamer::getChunk()
   {
     try
     {
+      if (itsPassThroughFlag)
+        return getPassThroughChunk();
+
       ostringstream chunkBuf;
       string chunk;
       std::size_t chunkBufLength = 0, nChunks = 0;
+      auto startTime = std::chrono::steady_clock::now();
 
       while (!itsDoneFlag)
       {
@@ -1827,14 +2457,20 @@ std::string GribStreamer::getChunk()
         nChunks++;
 
         if (chunk.empty())
+        {
           itsDoneFlag = true;
+
+          if (itsMessageSizes)
+            itsMessageSizes->complete = true;
+        }
         else
           chunkBufLength += chunk.length();
 
         // To avoid small chunk transfer overhead collect chunks until max chunk length or max count
-        // of collected chunks is reached
+        // of collected chunks is reached, or the time budget for the chunk is exceeded
 
-        if (itsDoneFlag || (nChunks >= itsMaxMsgChunks) || (chunkBufLength >= itsChunkLength))
+        if (itsDoneFlag || (nChunks >= itsMaxMsgChunks) || (chunkBufLength >= itsChunkLength) ||
+            chunkTimeBudgetExceeded(startTime))
         {
           if (itsDoneFlag)
             setStatus(ContentStreamer::StreamerStatus::EXIT_OK);
@@ -1855,10 +2491,15 @@ std::string GribStreamer::getChunk()
     }
     catch (...)
     {
-      Fmi::Exception exception(BCP, "Request processing exception!", nullptr);
-      exception.addParameter("URI", itsRequest.getURI());
+      // Cancellation has already been logged
+
+      if (!isCancelled())
+      {
+        Fmi::Exception exception(BCP, "Request processing exception!", nullptr);
+        exception.addParameter("URI", itsRequest.getURI());
 
-      std::cerr << exception.getStackTrace();
+        std::cerr << exception.getStackTrace();
+      }
     }
 
     setStatus(ContentStreamer::StreamerStatus::EXIT_ERROR);
@@ -1901,6 +2542,8 @@ void GribStreamer::getDataChunk(Engine::Querydata::Q q,
 
     chunk =
         getGribMessage(q, level, mt, values, itsScalingIterator->first, itsScalingIterator->second);
+
+    addMessageSize(chunk);
   }
   catch (...)
   {
@@ -1934,6 +2577,8 @@ void GribStreamer::getGridDataChunk(const QueryServer::Query &gridQuery,
 
     chunk = getGridGribMessage(
         gridQuery, level, mt, itsScalingIterator->first, itsScalingIterator->second);
+
+    addMessageSize(chunk);
   }
   catch (...)
   {
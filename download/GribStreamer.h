@@ -10,6 +10,8 @@
 #include "GribTools.h"
 #include <macgyver/DateTime.h>
 #include <boost/thread.hpp>
+#include <fstream>
+#include <set>
 
 namespace SmartMet
 {
@@ -29,6 +31,14 @@ class GribStreamer : public DataStreamer
 
   virtual std::string getChunk();
 
+  bool setGridContentPassThrough(const Engine::Grid::Engine* gridEngine);
+
+  virtual std::size_t skipBytes(std::size_t nBytes);
+  virtual std::optional<std::size_t> getOutputSize() const;
+  virtual std::size_t getSkippableSize() const;
+  virtual std::optional<std::size_t> getEstimatedOutputSize() const;
+  virtual void setMessageIndex(MessageIndex& messageIndex, const std::string& requestKey);
+
   virtual void getDataChunk(Engine::Querydata::Q q,
                             const NFmiArea* area,
                             NFmiGrid* grid,
@@ -49,7 +59,7 @@ class GribStreamer : public DataStreamer
   GribStreamer();
 
   grib_handle* itsGribHandle;
-  std::vector<double> itsValueArray;
+  std::vector<GribValue> itsValueArray;
   Fmi::DateTime itsGribOriginTime;
   bool itsGrib1Flag;
 
@@ -63,10 +73,16 @@ class GribStreamer : public DataStreamer
   void setMercatorGeometryToGrib() const;
   void setLambertConformalGeometryToGrib(const NFmiArea *area = nullptr) const;
   void setLambertAzimuthalEqualAreaGeometryToGrib() const;
-  void setNamedSettingsToGrib() const;
+  void setNamedSettingsToGrib();
   void setGeometryToGrib(const NFmiArea* area, bool relative_uv);
+  void setBitmapToGrib(bool hasMissingValues);
   std::string gribLevelTypeAndLevel(bool gridContent, FmiLevelType levelType, NFmiLevel *cfgLevel,
                                     int &level) const;
+  GribKeyValues getLevelAndParameterKeys(int level,
+                                         const NFmiParam& theParam,
+                                         const std::string& paramName,
+                                         const ParamChangeTable& pTable,
+                                         std::size_t& paramIdx) const;
   void setLevelAndParameterToGrib(int level,
                                   const NFmiParam& theParam,
                                   const std::string& paramName,
@@ -82,6 +98,8 @@ class GribStreamer : public DataStreamer
                        const NFmiDataMatrix<float>& dataValues,
                        float scale,
                        float offset);
+  void setPrecisionToGrib(const ParamChangeTable& pTable, std::size_t paramIdx);
+  void resetBitsPerValue();
   std::string getGribMessage(Engine::Querydata::Q q,
                              int level,
                              const NFmiMetTime& mt,
@@ -89,14 +107,41 @@ class GribStreamer : public DataStreamer
                              float scale,
                              float offset);
 
+  // Resolved level and parameter keys by parameter and level, and the keys currently set
+
+  struct LevelAndParameterKeys
+  {
+    GribKeyValues keyValues;
+    std::size_t paramIdx;
+  };
+
+  std::map<std::string, LevelAndParameterKeys> itsLevelAndParameterKeys;
+  const GribKeyValues* itsAppliedLevelAndParameterKeys = nullptr;
+
+  // Producer's named settings, set with level and parameter keys
+
+  GribKeyValues itsNamedSettings;
+  std::optional<std::string> itsNamedSettingsProducer;
+  std::optional<bool> itsBitmapPresent;
+  long itsSampleBitsPerValue = 0;         // Sample's bits per value
+  long itsDefaultBitsPerValue = 0;        // Configured or sample's bits per value
+  bool itsPrecisionBitsPerValue = false;  // Set if precision based bits per value is in use
+  std::set<std::size_t> itsPrecisionLimitedParams;  // Parameters (indexes) with unachievable
+                                                    // precision, logged once per request
+
+  // Sizes of generated messages; indexed sizes are used to skip messages when resuming the
+  // download, and the sizes of the messages generated by this request are stored to the index
+
+  MessageIndex* itsMessageIndex = nullptr;
+  std::string itsRequestKey;
+  std::shared_ptr<const MessageSizes> itsIndexedSizes;
+  std::shared_ptr<MessageSizes> itsMessageSizes;
+
+  void addMessageSize(const std::string& message);
+
   // Grid support
   //
 
-  std::string itsPreviousParam;
-  typedef std::map<std::string, int> ParamConfigProducerIndexes;
-  typedef std::map<std::string, ParamConfigProducerIndexes> ParamConfigParamIndexes;
-  ParamConfigParamIndexes paramConfigIndexes;
-
   void setGridGeometryToGrib(const QueryServer::Query& gridQuery);
   void addGridValuesToGrib(const QueryServer::Query& gridQuery,
                            const NFmiMetTime& vTime,
@@ -108,6 +153,22 @@ class GribStreamer : public DataStreamer
                                  const NFmiMetTime& mt,
                                  float scale,
                                  float offset);
+
+  // Source grib messages returned as is when no transformations are needed
+
+  struct PassThroughMessage
+  {
+    std::string fileName;
+    unsigned long long filePosition;
+    unsigned long long messageSize;
+  };
+
+  bool itsPassThroughFlag = false;
+  std::list<PassThroughMessage> itsPassThroughMessages;
+  std::string itsPassThroughFileName;
+  std::ifstream itsPassThroughStream;
+
+  std::string getPassThroughChunk();
 };
 
 }  // namespace Download
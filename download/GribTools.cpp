@@ -10,6 +10,7 @@
 
 #include <boost/lexical_cast.hpp>
 
+#include <cstring>
 #include <iostream>
 #include <stdexcept>
 
@@ -226,3 +227,112 @@ void gset(grib_handle *g, const char *name, const std::string &value)
     throw Fmi::Exception::Trace(BCP, "Operation failed!");
   }
 }
+
+void gset(grib_handle *g, const char *name, const std::vector<GribValue> &values)
+{
+  try
+  {
+#ifdef GRIB_FLOAT_VALUES
+    int err = grib_set_float_array(g, name, values.data(), values.size());
+#else
+    int err = grib_set_double_array(g, name, values.data(), values.size());
+#endif
+
+    if (err)
+      throw Fmi::Exception(BCP, "Failed to set '" + std::string(name) + "' array!");
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+// Add key and value to the set
+// ----------------------------------------------------------------------
+
+void GribKeyValues::add(const char *name, long value)
+{
+  KeyValue keyValue;
+
+  keyValue.name = name;
+  keyValue.type = GRIB_TYPE_LONG;
+  keyValue.longValue = value;
+
+  itsKeyValues.push_back(keyValue);
+}
+
+void GribKeyValues::add(const char *name, double value)
+{
+  KeyValue keyValue;
+
+  keyValue.name = name;
+  keyValue.type = GRIB_TYPE_DOUBLE;
+  keyValue.doubleValue = value;
+
+  itsKeyValues.push_back(keyValue);
+}
+
+void GribKeyValues::add(const char *name, const std::string &value)
+{
+  KeyValue keyValue;
+
+  keyValue.name = name;
+  keyValue.type = GRIB_TYPE_STRING;
+  keyValue.stringValue = value;
+
+  itsKeyValues.push_back(keyValue);
+}
+
+// ----------------------------------------------------------------------
+// Set the keys in given order
+// ----------------------------------------------------------------------
+
+void GribKeyValues::set(grib_handle *g) const
+{
+  try
+  {
+    if (itsKeyValues.empty())
+      return;
+
+    std::vector<grib_values> values(itsKeyValues.size());
+
+    for (std::size_t i = 0; (i < itsKeyValues.size()); i++)
+    {
+      auto const &keyValue = itsKeyValues[i];
+      auto &value = values[i];
+
+      memset(&value, 0, sizeof(value));
+
+      value.name = keyValue.name.c_str();
+      value.type = keyValue.type;
+      value.long_value = keyValue.longValue;
+      value.double_value = keyValue.doubleValue;
+      value.string_value = keyValue.stringValue.c_str();
+    }
+
+    if (grib_set_values(g, &values[0], values.size()))
+    {
+      for (std::size_t i = 0; (i < itsKeyValues.size()); i++)
+        if (values[i].error)
+        {
+          auto const &keyValue = itsKeyValues[i];
+          std::string value =
+              ((keyValue.type == GRIB_TYPE_LONG)
+                   ? boost::lexical_cast<std::string>(keyValue.longValue)
+                   : ((keyValue.type == GRIB_TYPE_DOUBLE)
+                          ? boost::lexical_cast<std::string>(keyValue.doubleValue)
+                          : keyValue.stringValue));
+
+          throw Fmi::Exception(
+              BCP, "Failed to set '" + keyValue.name + "' to value '" + value + "'!");
+        }
+
+      throw Fmi::Exception(BCP, "Failed to set grib keys!");
+    }
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
@@ -6,8 +6,20 @@
 
 #pragma once
 
+#include <eccodes_version.h>
 #include <grib_api.h>
 #include <string>
+#include <vector>
+
+// Float values can be set without converting them to double with eccodes 2.30.0 and later
+
+#if defined(ECCODES_MAJOR_VERSION) && defined(ECCODES_MINOR_VERSION) && \
+    ((ECCODES_MAJOR_VERSION > 2) || ((ECCODES_MAJOR_VERSION == 2) && (ECCODES_MINOR_VERSION >= 30)))
+#define GRIB_FLOAT_VALUES
+typedef float GribValue;
+#else
+typedef double GribValue;
+#endif
 
 // Debugging tools
 
@@ -24,3 +36,31 @@ void gset(grib_handle* g, const char* name, unsigned long value);
 void gset(grib_handle* g, const char* name, int value);
 void gset(grib_handle* g, const char* name, const char* value);
 void gset(grib_handle* g, const char* name, const std::string& value);
+void gset(grib_handle* g, const char* name, const std::vector<GribValue>& values);
+
+// Ordered set of keys and values set to grib with a single grib_set_values call
+
+class GribKeyValues
+{
+ public:
+  void add(const char* name, long value);
+  void add(const char* name, double value);
+  void add(const char* name, const std::string& value);
+
+  bool empty() const { return itsKeyValues.empty(); }
+  void clear() { itsKeyValues.clear(); }
+
+  void set(grib_handle* g) const;
+
+ private:
+  struct KeyValue
+  {
+    std::string name;
+    int type;
+    long longValue = 0;
+    double doubleValue = 0;
+    std::string stringValue;
+  };
+
+  std::vector<KeyValue> itsKeyValues;
+};
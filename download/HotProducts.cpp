@@ -0,0 +1,532 @@
+// ======================================================================
+/*!
+ * \brief SmartMet download service plugin; pregenerated products
+ */
+// ======================================================================
+
+#include "HotProducts.h"
+#include "Tools.h"
+#include <boost/algorithm/string/split.hpp>
+#include <boost/algorithm/string/classification.hpp>
+#include <macgyver/Exception.h>
+#include <macgyver/StringConversion.h>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <unistd.h>
+
+namespace
+{
+const std::size_t cachedProductChunkLength = 2048 * 2048;
+const std::string tmpSuffix = ".tmp";
+const std::string lockSuffix = ".lock";
+const std::string nameSuffix = ".name";
+
+// Temporary and lock files of abandoned (e.g. crashed) generators are removed after given age
+const auto tmpFileMaxAge = std::chrono::hours(1);
+
+std::atomic<unsigned long> tmpFileCounter{0};
+
+}  // namespace
+
+using namespace std;
+
+namespace SmartMet
+{
+namespace Plugin
+{
+namespace Download
+{
+// ----------------------------------------------------------------------
+/*!
+ * \brief Return pregenerated product file.
+ *
+ *		The file is opened immediately to keep it accessible even if it
+ *		is replaced by a newer product while being streamed
+ */
+// ----------------------------------------------------------------------
+
+CachedProductStreamer::CachedProductStreamer(const CachedProduct &product)
+    : Spine::HTTP::ContentStreamer()
+{
+  try
+  {
+    itsStream.open(product.path, ios::in | ios::binary);
+
+    if (!itsStream)
+      throw Fmi::Exception(BCP, "Unable to open product file").addParameter("File", product.path);
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+CachedProductStreamer::~CachedProductStreamer() {}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Get next chunk of the product file
+ */
+// ----------------------------------------------------------------------
+
+std::string CachedProductStreamer::getChunk()
+{
+  try
+  {
+    string chunk(cachedProductChunkLength, '\0');
+
+    itsStream.read(&chunk[0], cachedProductChunkLength);
+    chunk.resize(itsStream.gcount());
+
+    if (itsStream.bad())
+    {
+      setStatus(ContentStreamer::StreamerStatus::EXIT_ERROR);
+      return "";
+    }
+
+    if (itsStream.eof())
+      setStatus(ContentStreamer::StreamerStatus::EXIT_OK);
+
+    return chunk;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+HotProducts::~HotProducts()
+{
+  shutdown();
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Initialize configured products and start the background generation
+ */
+// ----------------------------------------------------------------------
+
+void HotProducts::init(const Config &config,
+                       KeyFunction keyFunction,
+                       StreamerFunction streamerFunction)
+{
+  try
+  {
+    for (auto const &options : config.getHotProducts())
+    {
+      Product product;
+      vector<string> params;
+
+      product.options = options;
+      boost::algorithm::split(params, options, boost::algorithm::is_any_of("&"));
+
+      for (auto const &param : params)
+      {
+        auto pos = param.find('=');
+
+        if ((pos == 0) || (pos == string::npos))
+          throw Fmi::Exception(BCP, "Invalid hot product request options")
+              .addParameter("Options", options);
+
+        product.request.setParameter(param.substr(0, pos), param.substr(pos + 1));
+      }
+
+      itsProducts.push_back(product);
+    }
+
+    if (itsProducts.empty())
+      return;
+
+    itsDirectory = config.getHotProductDirectory();
+    itsCheckInterval = config.getHotProductCheckInterval();
+    itsKeyFunction = keyFunction;
+    itsStreamerFunction = streamerFunction;
+
+    std::filesystem::create_directories(itsDirectory);
+
+    itsThread = std::thread(&HotProducts::run, this);
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Stop the background generation
+ */
+// ----------------------------------------------------------------------
+
+void HotProducts::shutdown()
+{
+  {
+    std::lock_guard<std::mutex> lock(itsMutex);
+    itsShutdownFlag = true;
+  }
+
+  itsCondition.notify_all();
+
+  if (itsThread.joinable())
+    itsThread.join();
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Get cached product for given request key
+ */
+// ----------------------------------------------------------------------
+
+std::optional<CachedProduct> HotProducts::find(const std::string &requestKey) const
+{
+  try
+  {
+    std::lock_guard<std::mutex> lock(itsMutex);
+
+    auto it = itsCache.find(requestKey);
+
+    if (it == itsCache.end())
+      return std::nullopt;
+
+    return it->second;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Background generation loop
+ */
+// ----------------------------------------------------------------------
+
+void HotProducts::run()
+{
+  while (true)
+  {
+    update();
+
+    std::unique_lock<std::mutex> lock(itsMutex);
+
+    if (itsCondition.wait_for(lock,
+                              std::chrono::seconds(itsCheckInterval),
+                              [this]() { return itsShutdownFlag; }))
+      return;
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Generate the products for which new data is available.
+ *
+ *		If another process has already generated the product, it is
+ *		picked up; if another process is generating it, it is picked up
+ *		on a later round
+ */
+// ----------------------------------------------------------------------
+
+void HotProducts::update()
+{
+  removeStaleTmpFiles();
+
+  for (auto &product : itsProducts)
+  {
+    {
+      std::lock_guard<std::mutex> lock(itsMutex);
+
+      if (itsShutdownFlag)
+        return;
+    }
+
+    try
+    {
+      auto requestKey = itsKeyFunction(product.request);
+
+      // Empty key if the data version can not be determined
+
+      if (requestKey.empty() || (product.cacheKey && (*product.cacheKey == requestKey)))
+        continue;
+
+      if ((!pickUp(product, requestKey)) && claim(requestKey))
+        generate(product, requestKey);
+    }
+    catch (...)
+    {
+      Fmi::Exception::Trace(BCP, "Hot product generation failed!")
+          .addParameter("Options", product.options)
+          .printError();
+    }
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Remove temporary and lock files left by abandoned (e.g. crashed)
+ *		product generation
+ */
+// ----------------------------------------------------------------------
+
+void HotProducts::removeStaleTmpFiles() const
+{
+  std::error_code ec;
+  auto now = std::filesystem::file_time_type::clock::now();
+
+  auto hasSuffix = [](const string &fileName, const string &suffix) {
+    return ((fileName.size() > suffix.size()) &&
+            (fileName.compare(fileName.size() - suffix.size(), string::npos, suffix) == 0));
+  };
+
+  for (auto const &file : std::filesystem::directory_iterator(itsDirectory, ec))
+  {
+    auto fileName = file.path().filename().string();
+
+    if ((!hasSuffix(fileName, tmpSuffix)) && (!hasSuffix(fileName, lockSuffix)))
+      continue;
+
+    auto mtime = file.last_write_time(ec);
+
+    if ((!ec) && ((now - mtime) > tmpFileMaxAge))
+      std::filesystem::remove(file.path(), ec);
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Get product file path for given request key.
+ *
+ *		The name is a fixed digest of the key, the same for all server
+ *		processes sharing the directory. The file name returned to the
+ *		client is stored in a separate file
+ */
+// ----------------------------------------------------------------------
+
+std::string HotProducts::productPath(const std::string &requestKey) const
+{
+  return itsDirectory + "/" + getDigest(requestKey);
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Claim generation of the product for given request key.
+ *
+ *		Returns false if another process is generating it
+ */
+// ----------------------------------------------------------------------
+
+bool HotProducts::claim(const std::string &requestKey) const
+{
+  try
+  {
+    auto lockPath = productPath(requestKey) + lockSuffix;
+    int fd = open(lockPath.c_str(), O_WRONLY | O_CREAT | O_EXCL, 0644);
+
+    if (fd < 0)
+    {
+      if (errno == EEXIST)
+        return false;
+
+      throw Fmi::Exception(BCP, "Unable to create product lock file")
+          .addParameter("File", lockPath)
+          .addParameter("Error", strerror(errno));
+    }
+
+    close(fd);
+
+    return true;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Pick up product generated by another process.
+ *
+ *		Returns false if the product file does not exist
+ */
+// ----------------------------------------------------------------------
+
+bool HotProducts::pickUp(Product &product, const std::string &requestKey)
+{
+  try
+  {
+    CachedProduct cachedProduct;
+    cachedProduct.path = productPath(requestKey);
+
+    // The file name file is written before the product file is renamed into place
+
+    std::error_code ec;
+    cachedProduct.size = std::filesystem::file_size(cachedProduct.path, ec);
+
+    if (ec)
+      return false;
+
+    ifstream in(cachedProduct.path + nameSuffix);
+
+    if (!getline(in, cachedProduct.fileName))
+      return false;
+
+    replace(product, requestKey, cachedProduct);
+
+    return true;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Generate claimed product.
+ *
+ *		The product is discarded if the data resolved by the streamer or
+ *		available after generating the product (e.g. for grid data the
+ *		origintime can be resolved by validtime while generating) does
+ *		not match the request key; it is then generated on a later round
+ */
+// ----------------------------------------------------------------------
+
+void HotProducts::generate(Product &product, const std::string &requestKey)
+{
+  string path = productPath(requestKey);
+  string lockPath = path + lockSuffix;
+
+  // The temporary file is unique for each process and generation
+
+  string tmpPath = path + "." + Fmi::to_string(getpid()) + "." +
+                   Fmi::to_string(tmpFileCounter++) + tmpSuffix;
+
+  try
+  {
+    // Another process may have completed the product after it was checked
+
+    if (pickUp(product, requestKey))
+    {
+      std::filesystem::remove(lockPath);
+      return;
+    }
+
+    string fileName, streamerKey;
+    auto streamer = itsStreamerFunction(product.request, fileName, streamerKey);
+
+    if ((!streamer) || (streamerKey != requestKey))
+    {
+      std::filesystem::remove(lockPath);
+      return;
+    }
+
+    ofstream out(tmpPath, ios::out | ios::binary | ios::trunc);
+
+    if (!out)
+      throw Fmi::Exception(BCP, "Unable to create product file").addParameter("File", tmpPath);
+
+    while (true)
+    {
+      auto chunk = streamer->getChunk();
+      out.write(chunk.data(), chunk.size());
+
+      auto status = streamer->getStatus();
+
+      if (status == Spine::HTTP::ContentStreamer::StreamerStatus::EXIT_ERROR)
+        throw Fmi::Exception(BCP, "Product generation failed");
+
+      if (status == Spine::HTTP::ContentStreamer::StreamerStatus::EXIT_OK)
+        break;
+    }
+
+    out.close();
+
+    if (out.fail())
+      throw Fmi::Exception(BCP, "Writing product file failed").addParameter("File", tmpPath);
+
+    // Release the admission ticket held by the streamer
+
+    streamer.reset();
+
+    if (itsKeyFunction(product.request) != requestKey)
+    {
+      std::filesystem::remove(tmpPath);
+      std::filesystem::remove(lockPath);
+      return;
+    }
+
+    ofstream name(path + nameSuffix, ios::out | ios::trunc);
+    name << fileName << endl;
+    name.close();
+
+    if (name.fail())
+      throw Fmi::Exception(BCP, "Writing product file name failed")
+          .addParameter("File", path + nameSuffix);
+
+    std::filesystem::rename(tmpPath, path);
+    std::filesystem::remove(lockPath);
+
+    CachedProduct cachedProduct;
+    cachedProduct.path = path;
+    cachedProduct.fileName = fileName;
+    cachedProduct.size = std::filesystem::file_size(path);
+
+    replace(product, requestKey, cachedProduct);
+  }
+  catch (...)
+  {
+    std::error_code ec;
+    std::filesystem::remove(tmpPath, ec);
+    std::filesystem::remove(lockPath, ec);
+
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Replace the previous product with the new one.
+ *
+ *		The previous product files are removed; another process may have
+ *		removed them already
+ */
+// ----------------------------------------------------------------------
+
+void HotProducts::replace(Product &product,
+                          const std::string &requestKey,
+                          const CachedProduct &cachedProduct)
+{
+  try
+  {
+    std::lock_guard<std::mutex> lock(itsMutex);
+
+    if (product.cacheKey)
+    {
+      auto it = itsCache.find(*product.cacheKey);
+
+      if ((it != itsCache.end()) && (it->second.path != cachedProduct.path))
+      {
+        std::error_code ec;
+        std::filesystem::remove(it->second.path, ec);
+        std::filesystem::remove(it->second.path + nameSuffix, ec);
+      }
+
+      itsCache.erase(*product.cacheKey);
+    }
+
+    itsCache[requestKey] = cachedProduct;
+    product.cacheKey = requestKey;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+}  // namespace Download
+}  // namespace Plugin
+}  // namespace SmartMet
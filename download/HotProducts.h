@@ -0,0 +1,132 @@
+// ======================================================================
+/*!
+ * \brief SmartMet download service plugin; pregenerated products
+ */
+// ======================================================================
+
+#pragma once
+
+#include "Config.h"
+#include "DataStreamer.h"
+#include <condition_variable>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <thread>
+
+namespace SmartMet
+{
+namespace Plugin
+{
+namespace Download
+{
+// ----------------------------------------------------------------------
+/*!
+ * \brief Pregenerated product file
+ */
+// ----------------------------------------------------------------------
+
+struct CachedProduct
+{
+  std::string path;      // Product file
+  std::string fileName;  // File name returned to the client
+  std::size_t size = 0;  // File size
+};
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Return pregenerated product file
+ */
+// ----------------------------------------------------------------------
+
+class CachedProductStreamer : public Spine::HTTP::ContentStreamer
+{
+ public:
+  CachedProductStreamer(const CachedProduct &product);
+  virtual ~CachedProductStreamer();
+
+  virtual std::string getChunk();
+
+ private:
+  CachedProductStreamer();
+
+  std::ifstream itsStream;
+};
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Pregeneration of configured products.
+ *
+ *        The products (canned request options) are checked periodically
+ *        in background and generated into the cache directory when new
+ *        data is available. The previous product file is removed when the
+ *        new one is ready. Requests matching the product and data (the
+ *        request key) are returned from the cache.
+ *
+ *        The directory can be shared by multiple server processes. Each
+ *        product is generated by the process claiming it first (by
+ *        creating a lock file); the other processes pick up the product
+ *        file when it is ready.
+ */
+// ----------------------------------------------------------------------
+
+class HotProducts
+{
+ public:
+  // Request key for current data (empty if the data version can not be determined), and data
+  // streamer for the request with the request key of the data resolved by the streamer.
+  // The streamer function returns nullptr if the product can not be generated now (e.g. the
+  // server is busy)
+  //
+  using KeyFunction = std::function<std::string(const Spine::HTTP::Request &)>;
+  using StreamerFunction = std::function<std::shared_ptr<DataStreamer>(
+      const Spine::HTTP::Request &, std::string &fileName, std::string &requestKey)>;
+
+  HotProducts() = default;
+  HotProducts(const HotProducts &other) = delete;
+  HotProducts &operator=(const HotProducts &other) = delete;
+  ~HotProducts();
+
+  void init(const Config &config, KeyFunction keyFunction, StreamerFunction streamerFunction);
+  void shutdown();
+
+  bool enabled() const { return (!itsProducts.empty()); }
+
+  std::optional<CachedProduct> find(const std::string &requestKey) const;
+
+ private:
+  struct Product
+  {
+    std::string options;                  // Request options as given in configuration
+    Spine::HTTP::Request request;         // Request to generate the product
+    std::optional<std::string> cacheKey;  // Request key of the cached product
+  };
+
+  void run();
+  void update();
+  void removeStaleTmpFiles() const;
+  std::string productPath(const std::string &requestKey) const;
+  bool claim(const std::string &requestKey) const;
+  bool pickUp(Product &product, const std::string &requestKey);
+  void generate(Product &product, const std::string &requestKey);
+  void replace(Product &product, const std::string &requestKey, const CachedProduct &cachedProduct);
+
+  std::list<Product> itsProducts;
+  std::string itsDirectory;
+  unsigned int itsCheckInterval = 0;
+
+  KeyFunction itsKeyFunction;
+  StreamerFunction itsStreamerFunction;
+
+  mutable std::mutex itsMutex;
+  std::condition_variable itsCondition;
+  std::map<std::string, CachedProduct> itsCache;  // Cached products by request key
+  bool itsShutdownFlag = false;
+  std::thread itsThread;
+};
+
+}  // namespace Download
+}  // namespace Plugin
+}  // namespace SmartMet
@@ -0,0 +1,125 @@
+// ======================================================================
+/*!
+ * \brief SmartMet download service plugin; sizes of generated grib
+ *        messages by request
+ */
+// ======================================================================
+
+#include "MessageIndex.h"
+#include <macgyver/Exception.h>
+#include <numeric>
+
+using namespace std;
+
+namespace SmartMet
+{
+namespace Plugin
+{
+namespace Download
+{
+// ----------------------------------------------------------------------
+/*!
+ * \brief Get total size of the messages
+ */
+// ----------------------------------------------------------------------
+
+std::size_t MessageSizes::outputSize() const
+{
+  return std::accumulate(sizes.begin(), sizes.end(), std::size_t(0));
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Initialize the index
+ */
+// ----------------------------------------------------------------------
+
+void MessageIndex::init(std::size_t maxEntries)
+{
+  itsMaxEntries = maxEntries;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Find message sizes for given request
+ */
+// ----------------------------------------------------------------------
+
+std::shared_ptr<const MessageSizes> MessageIndex::find(const std::string &requestKey)
+{
+  try
+  {
+    if (!enabled())
+      return nullptr;
+
+    std::lock_guard<std::mutex> lock(itsMutex);
+
+    auto it = itsEntries.find(requestKey);
+
+    if (it == itsEntries.end())
+      return nullptr;
+
+    itsLruList.splice(itsLruList.begin(), itsLruList, it->second.lruPosition);
+
+    return it->second.sizes;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Store message sizes for given request.
+ *
+ *		Existing entry is replaced only if the given sizes cover more
+ *		of the output (e.g. the previous download was interrupted).
+ *		Least recently used entries are removed to keep the index size
+ *		within the limit
+ */
+// ----------------------------------------------------------------------
+
+void MessageIndex::insert(const std::string &requestKey,
+                          const std::shared_ptr<const MessageSizes> &sizes)
+{
+  try
+  {
+    if ((!enabled()) || sizes->sizes.empty())
+      return;
+
+    std::lock_guard<std::mutex> lock(itsMutex);
+
+    auto it = itsEntries.find(requestKey);
+
+    if (it != itsEntries.end())
+    {
+      const auto &current = *(it->second.sizes);
+
+      if (current.complete || (current.sizes.size() >= sizes->sizes.size()))
+        return;
+
+      it->second.sizes = sizes;
+      itsLruList.splice(itsLruList.begin(), itsLruList, it->second.lruPosition);
+
+      return;
+    }
+
+    while ((!itsLruList.empty()) && (itsEntries.size() >= itsMaxEntries))
+    {
+      itsEntries.erase(itsLruList.back());
+      itsLruList.pop_back();
+    }
+
+    itsLruList.push_front(requestKey);
+    itsEntries.insert(make_pair(requestKey, Entry{sizes, itsLruList.begin()}));
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+}  // namespace Download
+}  // namespace Plugin
+}  // namespace SmartMet
@@ -0,0 +1,86 @@
+// ======================================================================
+/*!
+ * \brief SmartMet download service plugin; sizes of generated grib
+ *        messages by request
+ */
+// ======================================================================
+
+#pragma once
+
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace SmartMet
+{
+namespace Plugin
+{
+namespace Download
+{
+// ----------------------------------------------------------------------
+/*!
+ * \brief Sizes of the grib messages generated for a request
+ */
+// ----------------------------------------------------------------------
+
+struct MessageSizes
+{
+  std::vector<std::size_t> sizes;  // Message sizes in output order
+  bool complete = false;           // If set, contains all messages of the output
+
+  std::size_t outputSize() const;  // Total size of the messages
+};
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Memory index of generated grib message sizes.
+ *
+ *        The sizes are stored by request key when deterministic (fixed
+ *        origintime) grib output is generated. Requests resuming the
+ *        download use them to skip whole messages preceding the
+ *        requested byte range without generating them, and to know the
+ *        output size beforehand if all messages have been generated.
+ *        When the index size limit is exceeded, least recently used
+ *        entries are removed.
+ */
+// ----------------------------------------------------------------------
+
+class MessageIndex
+{
+ public:
+  MessageIndex() = default;
+  MessageIndex(const MessageIndex &other) = delete;
+  MessageIndex &operator=(const MessageIndex &other) = delete;
+
+  void init(std::size_t maxEntries);
+
+  bool enabled() const { return (itsMaxEntries > 0); }
+
+  // Returns message sizes or nullptr if not indexed
+
+  std::shared_ptr<const MessageSizes> find(const std::string &requestKey);
+
+  void insert(const std::string &requestKey, const std::shared_ptr<const MessageSizes> &sizes);
+
+ private:
+  using LruList = std::list<std::string>;
+
+  struct Entry
+  {
+    std::shared_ptr<const MessageSizes> sizes;
+    LruList::iterator lruPosition;
+  };
+
+  std::size_t itsMaxEntries = 0;  // If 0, the index is disabled
+
+  std::mutex itsMutex;
+  std::map<std::string, Entry> itsEntries;
+  LruList itsLruList;  // Request keys, most recently used first
+};
+
+}  // namespace Download
+}  // namespace Plugin
+}  // namespace SmartMet
@@ -13,11 +13,48 @@
 #include <newbase/NFmiMetTime.h>
 #include <newbase/NFmiQueryData.h>
 #include <spine/Thread.h>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
 
 namespace
 {
 // NcFile::Open does not seem to be thread safe
 SmartMet::Spine::MutexType myFileOpenMutex;
+
+// Number of mantissa bits in float
+const int floatMantissaBits = 23;
+
+// Maximum number of values buffered for a single netcdf putVar() call
+const std::size_t maxSlabValues = 4 * 1024 * 1024;
+
+// Round float values to given number of mantissa bits (round to nearest, ties to even), leaving
+// missing and non-finite values as is. Zeroed trailing bits make the output compress better
+
+void bitRound(float *values, std::size_t nValues, unsigned int keepBits, float missingValue)
+{
+  if (keepBits >= floatMantissaBits)
+    return;
+
+  const unsigned int dropBits = floatMantissaBits - keepBits;
+  const uint32_t mask = (~uint32_t(0)) << dropBits;
+  const uint32_t half = (uint32_t(1) << (dropBits - 1)) - 1;
+
+  for (std::size_t i = 0; (i < nValues); i++)
+  {
+    if ((values[i] == missingValue) || (!std::isfinite(values[i])))
+      continue;
+
+    uint32_t bits;
+    memcpy(&bits, &values[i], sizeof(bits));
+
+    bits += half + ((bits >> dropBits) & 1);
+    bits &= mask;
+
+    memcpy(&values[i], &bits, sizeof(bits));
+  }
+}
 }  // namespace
 
 #define CHECK(x, message) try { x; } catch (...) { throw Fmi::Exception(BCP, message); }
@@ -43,6 +80,9 @@ NetCdfStreamer::NetCdfStreamer(const Spine::HTTP::Request &req,
                   "_" + boost::lexical_cast<string>(boost::this_thread::get_id())),
       itsLoadedFlag(false)
 {
+  // The whole file is built before returning it; querydata grids can be extracted in parallel
+
+  itsParallelExtraction = true;
 }
 
 NetCdfStreamer::~NetCdfStreamer()
@@ -95,6 +135,11 @@ std::string NetCdfStreamer::getChunk()
           // Note: the data is loaded from 'itsGridValues'; 'chunk' serves only as 'end of data'
           // indicator.
           //
+          // If the time budget for the chunk is exceeded, the leading part of the file
+          // (headers and the variables already stored) is returned while loading the data
+          //
+          auto startTime = std::chrono::steady_clock::now();
+
           do
           {
             extractData(chunk);
@@ -102,7 +147,21 @@ std::string NetCdfStreamer::getChunk()
             if (chunk.empty())
               itsLoadedFlag = true;
             else
+            {
               storeParamValues();
+              itsStoredFlag = true;
+
+              if (chunkTimeBudgetExceeded(startTime))
+              {
+                // Buffered values must be written before returning the stored part of the file
+
+                flushParamValues();
+                chunk = getStoredDataChunk();
+
+                if (!chunk.empty())
+                  return chunk;
+              }
+            }
           } while (!itsLoadedFlag);
 
           // Then outputting the file/data in chunks
@@ -118,12 +177,16 @@ std::string NetCdfStreamer::getChunk()
           if (!itsFile)
             throw Fmi::Exception(BCP, "Netcdf file object is unset");
 
+          flushParamValues();
           itsFile->close();
 
-          itsStream.open(itsFilename, ifstream::in | ifstream::binary);
+          if (!itsStream.is_open())
+          {
+            itsStream.open(itsFilename, ifstream::in | ifstream::binary);
 
-          if (!itsStream)
-            throw Fmi::Exception(BCP, "Unable to open file stream");
+            if (!itsStream)
+              throw Fmi::Exception(BCP, "Unable to open file stream");
+          }
         }
 
         if (!itsStream.eof())
@@ -148,10 +211,15 @@ std::string NetCdfStreamer::getChunk()
     }
     catch (...)
     {
-      Fmi::Exception exception(BCP, "Request processing exception!", nullptr);
-      exception.addParameter("URI", itsRequest.getURI());
+      // Cancellation has already been logged
+
+      if (!isCancelled())
+      {
+        Fmi::Exception exception(BCP, "Request processing exception!", nullptr);
+        exception.addParameter("URI", itsRequest.getURI());
 
-      std::cerr << exception.getStackTrace();
+        std::cerr << exception.getStackTrace();
+      }
     }
 
     setStatus(ContentStreamer::StreamerStatus::EXIT_ERROR);
@@ -165,6 +233,82 @@ std::string NetCdfStreamer::getChunk()
   }
 }
 
+// ----------------------------------------------------------------------
+/*!
+ * \brief Get next chunk of the already stored leading part of the netcdf file.
+ *
+ *		The file is in classic format with fixed size dimensions only; the
+ *		header and all variables are allocated (filled with fill values) when
+ *		leaving define mode, and the variables are stored in the file in the
+ *		order they were defined. The part of the file preceding the current
+ *		and remaining data variables does not change anymore.
+ *
+ *		Returns empty chunk if no new data is available
+ */
+// ----------------------------------------------------------------------
+
+std::string NetCdfStreamer::getStoredDataChunk()
+{
+  try
+  {
+    if ((!itsFile) || (!itsStoredFlag) || (itsVarIterator == itsDataVars.end()))
+      return "";
+
+    // With grid content multiple parameters can be stored into the same variable, the variables
+    // are not necessarily stored in definition order
+
+    int minVarId = itsVarIterator->getId();
+
+    for (auto it = itsVarIterator; (it != itsDataVars.end()); it++)
+      minVarId = min(minVarId, it->getId());
+
+    itsFile->sync();
+
+    std::size_t fileSize = std::filesystem::file_size(itsFilename), unstoredSize = 0;
+
+    for (auto const &var : itsFile->getVars())
+      if (var.second.getId() >= minVarId)
+      {
+        std::size_t varSize = var.second.getType().getSize();
+
+        for (auto const &dim : var.second.getDims())
+          varSize *= dim.getSize();
+
+        // Variable sizes are rounded up to 4 byte boundary
+
+        unstoredSize += (((varSize + 3) / 4) * 4);
+      }
+
+    if (unstoredSize >= fileSize)
+      return "";
+
+    if (!itsStream.is_open())
+    {
+      itsStream.open(itsFilename, ifstream::in | ifstream::binary);
+
+      if (!itsStream)
+        throw Fmi::Exception(BCP, "Unable to open file stream");
+    }
+
+    std::size_t storedSize = fileSize - unstoredSize;
+    std::size_t streamPos = itsStream.tellg();
+
+    if (streamPos >= storedSize)
+      return "";
+
+    string chunk(min<std::size_t>(storedSize - streamPos, itsChunkLength), '\0');
+
+    itsStream.read(&chunk[0], chunk.size());
+    chunk.resize(itsStream.gcount());
+
+    return chunk;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
 // void dimDeleter(const netCDF::NcDim& /* dim */) {}
 
 // ----------------------------------------------------------------------
@@ -574,7 +718,6 @@ void NetCdfStreamer::addEnsembleDimensions()
 {
   try
   {
-    vector<string> paramParts;
     string ensembleDimName;
 
     for (auto it = itsDataParams.begin(); (it != itsDataParams.end()); it++)
@@ -583,9 +726,9 @@ void NetCdfStreamer::addEnsembleDimensions()
       //
       // Take forecast type/number from radon parameter names, e.g. T-K:MEPS:1093:2:92500:3:3
 
-      itsQuery.parseRadonParameterName(it->name(), paramParts);
-      auto forecastType = getForecastType(it->name(), paramParts);
-      auto forecastNumber = getForecastNumber(it->name(), paramParts);
+      const auto &radonParameter = itsQuery.getRadonParameter(it->name());
+      auto forecastType = radonParameter.forecastType;
+      auto forecastNumber = radonParameter.forecastNumber;
 
       // Ensemble dimension might already be created or is not created at all for given parameter
 
@@ -1861,9 +2004,10 @@ void NetCdfStreamer::addVariables(bool relative_uv)
 
         radonParam = paramParts.front();
 
-        for (i = j = 0; (i < pTable.size()); ++i)
-          if (pTable[i].itsRadonName == radonParam)
-            break;
+        const auto &indexes = pTable.getIndexesByRadonName(radonParam);
+
+        i = (indexes.empty() ? pTable.size() : indexes.front());
+        j = 0;
 
         if (i >= pTable.size())
           throw Fmi::Exception(
@@ -1891,18 +2035,23 @@ void NetCdfStreamer::addVariables(bool relative_uv)
       }
       else
       {
-        for (i = j = 0; i < pTable.size(); ++i)
-          if (usedParId == pTable[i].itsWantedParam.GetIdent())
+        i = pTable.size();
+        j = 0;
+
+        for (auto idx : pTable.getIndexesByParamId((unsigned long) usedParId))
+        {
+          if (relative_uv == (pTable[idx].itsGridRelative ? *pTable[idx].itsGridRelative : false))
           {
-            if (relative_uv == (pTable[i].itsGridRelative ? *pTable[i].itsGridRelative : false))
-              break;
-            else if (j == 0)
-              j = i + 1;
-            else
-              throw Fmi::Exception(BCP,
-                                   "Missing gridrelative configuration for parameter " +
-                                       boost::lexical_cast<string>(usedParId));
+            i = idx;
+            break;
           }
+          else if (j == 0)
+            j = idx + 1;
+          else
+            throw Fmi::Exception(BCP,
+                                 "Missing gridrelative configuration for parameter " +
+                                     boost::lexical_cast<string>(usedParId));
+        }
       }
 
       NcDim dimensions[] = {
@@ -1979,6 +2128,29 @@ void NetCdfStreamer::addVariables(bool relative_uv)
       if (!itsYDim.isNull())
         dataVar.putAtt("coordinates", "lat lon");
 
+      // Bit-rounding with the requested or configured number of significant bits or with the
+      // configured precision
+
+      BitRounding bitRounding;
+
+      if (itsReqParams.significantBits > 0)
+        bitRounding.significantBits = itsReqParams.significantBits;
+      else if (i < pTable.size())
+      {
+        bitRounding.significantBits = pTable[i].itsSignificantBits;
+
+        if (!bitRounding.significantBits)
+          bitRounding.precision = pTable[i].itsPrecision;
+      }
+
+      if (bitRounding.significantBits)
+        dataVar.putAtt("_QuantizeBitRoundNumberOfSignificantBits",
+                       NcType::nc_INT,
+                       int(*bitRounding.significantBits));
+
+      if (bitRounding.significantBits || bitRounding.precision)
+        itsVarBitRounding[dataVar.getName()] = bitRounding;
+
       itsDataVars.push_back(dataVar);
 
       if (gridContent)
@@ -1997,69 +2169,66 @@ void NetCdfStreamer::addVariables(bool relative_uv)
 
 // ----------------------------------------------------------------------
 /*!
- * \brief Store current parameter's/grid's values.
+ * \brief Bit-round a grid's values.
  *
+ *		When precision is configured, the number of significant bits is
+ *		selected so that the rounding step of the largest absolute value
+ *		does not exceed the precision
  */
 // ----------------------------------------------------------------------
 
-void NetCdfStreamer::storeParamValues()
+void NetCdfStreamer::bitRoundValues(const BitRounding &bitRounding,
+                                    float *values,
+                                    std::size_t nValues,
+                                    float missingValue) const
 {
   try
   {
-    // Load scaled values into a continuous buffer, cropping the grid/values if manual cropping is
-    // set
-    //
-    // Note: Using heap because buffer size might exceed stack size
+    if (bitRounding.significantBits)
+    {
+      bitRound(values, nValues, *bitRounding.significantBits, missingValue);
+      return;
+    }
 
-    bool cropxy = (itsCropping.cropped && itsCropping.cropMan);
-    size_t x0 = (cropxy ? itsCropping.bottomLeftX : 0), y0 = (cropxy ? itsCropping.bottomLeftY : 0);
-    size_t xN = (itsCropping.cropped ? (x0 + itsCropping.gridSizeX) : itsReqGridSizeX),
-           yN = (itsCropping.cropped ? (y0 + itsCropping.gridSizeY) : itsReqGridSizeY);
-    size_t xStep = (itsReqParams.gridStepXY ? (*(itsReqParams.gridStepXY))[0].first : 1),
-           yStep = (itsReqParams.gridStepXY ? (*(itsReqParams.gridStepXY))[0].second : 1), x, y;
+    float maxAbsValue = 0;
 
-    std::shared_ptr<float[]> values(new float[itsNY * itsNX]);
+    for (std::size_t i = 0; (i < nValues); i++)
+      if ((values[i] != missingValue) && std::isfinite(values[i]))
+        maxAbsValue = max(maxAbsValue, std::fabs(values[i]));
 
-    int i = 0;
+    if (maxAbsValue == 0)
+      return;
 
-    if (itsReqParams.dataSource == QueryData)
-    {
-      for (y = y0; (y < yN); y += yStep)
-        for (x = x0; (x < xN); x += xStep, i++)
-        {
-          auto value = itsGridValues[x][y];
+    // Rounding step of value 2^e * 1.m with n significant bits is 2^(e - n)
 
-          if (value != kFloatMissing)
-            values[i] = (value + itsScalingIterator->second) / itsScalingIterator->first;
-          else
-            values[i] = value;
-        }
-    }
-    else
-    {
-      const auto vVec = &(getValueListItem(itsGridQuery)->mValueVector);
-      bool gridContent = (itsReqParams.dataSource == GridContent);
+    int exponent = ilogb(maxAbsValue);
+    double bits = ceil(exponent - log2(*bitRounding.precision));
+    unsigned int keepBits =
+        ((bits < 1) ? 1 : ((bits >= floatMantissaBits) ? floatMantissaBits : (unsigned int) bits));
 
-      for (y = y0; (y < yN); y += yStep)
-        for (x = x0; (x < xN); x += xStep, i++)
-        {
-          auto c = (y * xN) + x;
-          auto value = (*vVec)[c];
+    bitRound(values, nValues, keepBits, missingValue);
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
 
-          if (value != ParamValueMissing)
-          {
-            if (gridContent)
-              values[i] = value;
-            else
-              values[i] = (value + itsScalingIterator->second) / itsScalingIterator->first;
-          }
-          else
-            values[i] = gribMissingValue;
-        }
-    }
+// ----------------------------------------------------------------------
+/*!
+ * \brief Store current parameter's/grid's values.
+ *
+ *		The values are loaded into the slab buffer. Consecutive validtimes
+ *		of a variable's level/ensemble member are collected into the same
+ *		slab, the buffered values are written when the grid does not
+ *		continue the slab or the slab size limit is reached
+ */
+// ----------------------------------------------------------------------
 
-    // Store the values for current parameter/[level/]validtime.
-    //
+void NetCdfStreamer::storeParamValues()
+{
+  try
+  {
     // First skip variables for missing parameters if any.
     //
     // Note: with querydata timeIndex was incremented after getting the data
@@ -2079,7 +2248,8 @@ void NetCdfStreamer::storeParamValues()
     // Note: when querying with radon parameter names (when gridContent is true) itsEnsembleDim
     // and/or itsLevelDim is set if any on the parameters has ensemble and/or level dimension
     // (created by addEnsembleDimensions() and addLevelDimensions()); ensemble and/or level
-    // dimension may not exist for given parameter.
+    // dimension may not exist for given parameter. The dimensions are resolved once per
+    // parameter.
     //
     // With non-gridContent query all parameters have or have not ensemble and/or level dimension
     // as indicated by itsEnsembleDim and itsLevelDim; ensemble is not used with querydata source
@@ -2093,29 +2263,49 @@ void NetCdfStreamer::storeParamValues()
 
     if (gridContent)
     {
-      vector<string> paramParts;
-      itsQuery.parseRadonParameterName(itsParamIterator->name(), paramParts);
+      auto &paramDims = itsParamDimensions;
 
-      if (!itsEnsembleDim.isNull())
+      if (paramDims.paramName != itsParamIterator->name())
       {
-        // Get ensemble dimension
+        const auto &radonParameter = itsQuery.getRadonParameter(itsParamIterator->name());
 
-        auto forecastType = getForecastType(itsParamIterator->name(), paramParts);
-        auto forecastNumber = getForecastNumber(itsParamIterator->name(), paramParts);
+        paramDims.paramName = itsParamIterator->name();
+        paramDims.ensembleDim = itsEnsembleDim;
+        paramDims.levelDim = itsLevelDim;
 
-        ensembleDim = getEnsembleDimension(forecastType, forecastNumber);
-      }
+        if (!itsEnsembleDim.isNull())
+        {
+          // Get ensemble dimension
 
-      if (!itsLevelDim.isNull())
-      {
-        // Get level dimension and index
+          paramDims.ensembleDim =
+              getEnsembleDimension(radonParameter.forecastType, radonParameter.forecastNumber);
+        }
+
+        if (!itsLevelDim.isNull())
+        {
+          // Get level dimension and index
 
-        int level = getParamLevel(itsParamIterator->name(), paramParts);
+          int level = radonParameter.level;
 
-        levelDim = getLevelDimAndIndex(itsParamIterator->name(), level, levelIndex);
+          paramDims.levelDim =
+              getLevelDimAndIndex(itsParamIterator->name(), level, paramDims.levelIndex);
+        }
       }
+
+      ensembleDim = paramDims.ensembleDim;
+      levelDim = paramDims.levelDim;
+
+      if (!itsLevelDim.isNull())
+        levelIndex = paramDims.levelIndex;
     }
 
+    bool cropxy = (itsCropping.cropped && itsCropping.cropMan);
+    size_t x0 = (cropxy ? itsCropping.bottomLeftX : 0), y0 = (cropxy ? itsCropping.bottomLeftY : 0);
+    size_t xN = (itsCropping.cropped ? (x0 + itsCropping.gridSizeX) : itsReqGridSizeX),
+           yN = (itsCropping.cropped ? (y0 + itsCropping.gridSizeY) : itsReqGridSizeY);
+    size_t xStep = (itsReqParams.gridStepXY ? (*(itsReqParams.gridStepXY))[0].first : 1),
+           yStep = (itsReqParams.gridStepXY ? (*(itsReqParams.gridStepXY))[0].second : 1), x, y;
+
     const bool hasLevelDim = !levelDim.isNull();
     std::size_t nX = (long)itsNX, nY = (long)itsNY;
 
@@ -2129,8 +2319,10 @@ void NetCdfStreamer::storeParamValues()
     }
 
     // Time dimension is always after it or the first if ensemble is not used
+    std::size_t timeDim = offsets.size();
+
     offsets.push_back(timeIndex);
-    edges.push_back(1);  // Time dimension, edge length 1
+    edges.push_back(1);  // Time dimension, edge length 1 (number of grids in the slab)
 
     if (hasLevelDim)
     {
@@ -2144,8 +2336,125 @@ void NetCdfStreamer::storeParamValues()
     offsets.push_back(x0);
     edges.push_back(nX);  // X dimension, edge length nX
 
-    itsVarIterator->putVar(offsets, edges, values.get());
+    // Append the values to the current slab if the grid is the next validtime of the same
+    // variable and level/ensemble member; otherwise write the buffered values and start a new
+    // slab
+
+    auto &slab = itsValueSlab;
+    std::size_t gridSize = nX * nY;
+    bool continuesSlab = false;
+
+    if ((slab.nGrids > 0) && (slab.var == *itsVarIterator) && (slab.timeDim == timeDim) &&
+        ((slab.values.size() + gridSize) <= maxSlabValues))
+    {
+      auto nextOffsets = slab.offsets;
+      nextOffsets[timeDim] += slab.nGrids;
+
+      continuesSlab = (nextOffsets == offsets);
+    }
+
+    if (!continuesSlab)
+    {
+      flushParamValues();
+
+      auto it = itsVarBitRounding.find(itsVarIterator->getName());
+
+      slab.var = *itsVarIterator;
+      slab.offsets = offsets;
+      slab.edges = edges;
+      slab.timeDim = timeDim;
+      slab.bitRounding = ((it != itsVarBitRounding.end()) ? &it->second : nullptr);
+    }
+
+    // Load scaled values into the slab buffer, cropping the grid/values if manual cropping is
+    // set
+
+    std::size_t slabOffset = slab.values.size();
+    slab.values.resize(slabOffset + gridSize);
+
+    float *values = &slab.values[slabOffset];
+    std::size_t i = 0;
+
+    if (itsReqParams.dataSource == QueryData)
+    {
+      for (y = y0; (y < yN); y += yStep)
+        for (x = x0; (x < xN); x += xStep, i++)
+        {
+          auto value = itsGridValues[x][y];
+
+          if (value != kFloatMissing)
+            values[i] = (value + itsScalingIterator->second) / itsScalingIterator->first;
+          else
+            values[i] = value;
+        }
+    }
+    else
+    {
+      const auto vVec = &(getValueListItem(itsGridQuery)->mValueVector);
+
+      for (y = y0; (y < yN); y += yStep)
+        for (x = x0; (x < xN); x += xStep, i++)
+        {
+          auto c = (y * xN) + x;
+          auto value = (*vVec)[c];
+
+          if (value != ParamValueMissing)
+          {
+            if (gridContent)
+              values[i] = value;
+            else
+              values[i] = (value + itsScalingIterator->second) / itsScalingIterator->first;
+          }
+          else
+            values[i] = gribMissingValue;
+        }
+    }
+
+    // Bit-rounding is done per grid since the number of significant bits can depend on
+    // grid's value range
+
+    if (slab.bitRounding)
+    {
+      float missingValue =
+          (itsReqParams.dataSource == QueryData) ? kFloatMissing : gribMissingValue;
+
+      bitRoundValues(*slab.bitRounding, values, i, missingValue);
+    }
+
+    slab.nGrids++;
+    slab.edges[timeDim] = slab.nGrids;
+
+    if (slab.values.size() >= maxSlabValues)
+      flushParamValues();
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Write the buffered values (slab) into the file
+ *
+ */
+// ----------------------------------------------------------------------
+
+void NetCdfStreamer::flushParamValues()
+{
+  try
+  {
+    auto &slab = itsValueSlab;
+
+    if (slab.nGrids == 0)
+      return;
+
+    // Note: the buffer is cleared but its storage is kept for the next slab
+
+    slab.var.putVar(slab.offsets, slab.edges, slab.values.data());
 
+    slab.nGrids = 0;
+    slab.values.clear();
   }
   catch (...)
   {
@@ -7,9 +7,12 @@
 #pragma once
 
 #include "DataStreamer.h"
+#include <map>
 #include <memory>
+#include <optional>
 #include <type_traits>
 #include <typeindex>
+#include <vector>
 #include <ncDim.h>
 #include <ncFile.h>
 #include <ncVar.h>
@@ -51,11 +54,13 @@ class NetCdfStreamer : public DataStreamer
  private:
   NetCdfStreamer();
   void requireNcFile();
+  std::string getStoredDataChunk();
 
   std::string itsFilename;
   std::unique_ptr<netCDF::NcFile> itsFile;
   std::ifstream itsStream;
   bool itsLoadedFlag;
+  bool itsStoredFlag = false;  // Set when data has been stored into the file
 
   // Note: netcdf file object owns dimensions and variables (could use plain pointers instead of
   // shared_ptr:s)
@@ -68,6 +73,45 @@ class NetCdfStreamer : public DataStreamer
   std::list<netCDF::NcVar>::iterator itsVarIterator;
   std::list<netCDF::NcVar> itsDataVars;
 
+  // Bit-rounding of variable values; fixed number of significant bits or the number of bits
+  // derived from the precision and the value range of each grid
+
+  struct BitRounding
+  {
+    std::optional<unsigned int> significantBits;
+    std::optional<float> precision;
+  };
+
+  std::map<std::string, BitRounding> itsVarBitRounding;
+
+  // Values of consecutive validtimes of a variable are buffered into a slab written with a
+  // single putVar() call; the buffer is reused for the successive slabs
+
+  struct ValueSlab
+  {
+    netCDF::NcVar var;
+    std::vector<std::size_t> offsets;          // Offsets of the first grid
+    std::vector<std::size_t> edges;            // Edge lengths of the slab
+    std::size_t timeDim = 0;                   // Index of time dimension in offsets/edges
+    std::size_t nGrids = 0;                    // Number of buffered grids
+    const BitRounding *bitRounding = nullptr;  // Variable's bit-rounding if any
+    std::vector<float> values;
+  };
+
+  ValueSlab itsValueSlab;
+
+  // Ensemble and level dimension of the current (radon) parameter with grid content
+
+  struct ParamDimensions
+  {
+    std::string paramName;
+    netCDF::NcDim ensembleDim;
+    netCDF::NcDim levelDim;
+    int levelIndex = 0;
+  };
+
+  ParamDimensions itsParamDimensions;
+
   typedef std::map<std::string, std::set<int>> DimensionLevels;
   DimensionLevels itsDimensionLevels;
   typedef std::map<std::string, std::string> LevelDimensions;
@@ -135,7 +179,12 @@ class NetCdfStreamer : public DataStreamer
                         std::map<std::string, netCDF::NcVar> &paramVariables);
   void addVariables(bool relative_uv);
 
+  void bitRoundValues(const BitRounding &bitRounding,
+                      float *values,
+                      std::size_t nValues,
+                      float missingValue) const;
   void storeParamValues();
+  void flushParamValues();
 
   void paramChanged(size_t nextParamOffset = 1);
 
@@ -0,0 +1,240 @@
+// ======================================================================
+/*!
+ * \brief SmartMet download service plugin; waiting for new data
+ */
+// ======================================================================
+
+#include "OriginTimeWatcher.h"
+#include "Tools.h"
+#include <macgyver/Exception.h>
+#include <macgyver/TimeParser.h>
+#include <vector>
+
+using namespace std;
+
+namespace SmartMet
+{
+namespace Plugin
+{
+namespace Download
+{
+OriginTimeWatcher::~OriginTimeWatcher()
+{
+  shutdown();
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Initialize and start checking for new data in background
+ */
+// ----------------------------------------------------------------------
+
+void OriginTimeWatcher::init(const Engine::Querydata::Engine *qEngine,
+                             const Engine::Grid::Engine *gridEngine,
+                             unsigned int checkInterval,
+                             unsigned int maxWaiters)
+{
+  try
+  {
+    itsQEngine = qEngine;
+    itsGridEngine = gridEngine;
+    itsCheckInterval = checkInterval;
+    itsMaxWaiters = maxWaiters;
+
+    itsThread = std::thread(&OriginTimeWatcher::run, this);
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Stop checking for new data and wake up the waiting requests
+ */
+// ----------------------------------------------------------------------
+
+void OriginTimeWatcher::shutdown()
+{
+  {
+    std::lock_guard<std::mutex> lock(itsMutex);
+    itsShutdownFlag = true;
+  }
+
+  itsCondition.notify_all();
+
+  if (itsThread.joinable())
+    itsThread.join();
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Get the latest origintime of a producer.
+ *
+ *		For grid data the latest valid (ready) generation is used
+ */
+// ----------------------------------------------------------------------
+
+Fmi::DateTime OriginTimeWatcher::latestOriginTime(const ProducerKey &producerKey) const
+{
+  try
+  {
+    const auto &producer = producerKey.first;
+    bool gridData = producerKey.second;
+
+    if (!gridData)
+      return itsQEngine->get(producer)->originTime();
+
+    if ((!itsGridEngine) || (!itsGridEngine->isEnabled()))
+      throw Fmi::Exception(BCP, "Grid data is not available");
+
+    auto cS = itsGridEngine->getContentServer_sptr();
+    T::GenerationInfoList generationInfoList;
+
+    generationInfoList.setComparisonMethod(T::GenerationInfo::ComparisonMethod::analysisTime);
+    cS->getGenerationInfoListByProducerName(0, producer, generationInfoList);
+
+    // Generations are fetched to ascending analysistime order
+
+    for (auto idx = generationInfoList.getLength(); (idx > 0); idx--)
+    {
+      auto generationInfo = generationInfoList.getGenerationInfoByIndex(idx - 1);
+
+      if (isValidGeneration(generationInfo))
+        return Fmi::TimeParser::parse(generationInfo->mAnalysisTime);
+    }
+
+    throw Fmi::Exception(BCP, "No data available").addParameter("Producer", producer);
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Wait for origintime later than given origintime.
+ *
+ *		Waits until later origintime is available, the timeout expires
+ *		or the server is shutting down, and sets origintime to the latest
+ *		origintime. If origintime is not given, waits for the origintime
+ *		following the current latest. If the max number of requests are
+ *		already waiting, returns an empty value without waiting
+ */
+// ----------------------------------------------------------------------
+
+std::optional<bool> OriginTimeWatcher::waitForOriginTime(const std::string &producer,
+                                                         bool gridData,
+                                                         Fmi::DateTime &originTime,
+                                                         unsigned int timeout)
+{
+  try
+  {
+    ProducerKey producerKey(producer, gridData);
+    auto latest = latestOriginTime(producerKey);
+
+    if (originTime.is_not_a_date_time())
+      originTime = latest;
+
+    if ((timeout == 0) || (latest > originTime))
+    {
+      bool updated = (latest > originTime);
+      originTime = latest;
+
+      return updated;
+    }
+
+    std::unique_lock<std::mutex> lock(itsMutex);
+
+    if (itsWaiters >= itsMaxWaiters)
+      return std::nullopt;
+
+    auto &watch = itsWatches[producerKey];
+
+    if (watch.originTime.is_not_a_date_time() || (latest > watch.originTime))
+      watch.originTime = latest;
+
+    watch.waiters++;
+    itsWaiters++;
+
+    itsCondition.wait_for(lock, std::chrono::seconds(timeout), [&]() {
+      return (itsShutdownFlag || (watch.originTime > originTime));
+    });
+
+    bool updated = (watch.originTime > originTime);
+    originTime = watch.originTime;
+
+    itsWaiters--;
+
+    if (--watch.waiters == 0)
+      itsWatches.erase(producerKey);
+
+    return updated;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Background loop checking the latest origintimes of the producers
+ *        having waiting requests
+ */
+// ----------------------------------------------------------------------
+
+void OriginTimeWatcher::run()
+{
+  while (true)
+  {
+    vector<ProducerKey> producerKeys;
+
+    {
+      std::unique_lock<std::mutex> lock(itsMutex);
+
+      if (itsCondition.wait_for(lock,
+                                std::chrono::seconds(itsCheckInterval),
+                                [this]() { return itsShutdownFlag; }))
+        return;
+
+      for (auto const &watch : itsWatches)
+        producerKeys.push_back(watch.first);
+    }
+
+    bool updated = false;
+
+    for (auto const &producerKey : producerKeys)
+    {
+      try
+      {
+        auto latest = latestOriginTime(producerKey);
+
+        std::lock_guard<std::mutex> lock(itsMutex);
+
+        auto it = itsWatches.find(producerKey);
+
+        if ((it != itsWatches.end()) && (latest > it->second.originTime))
+        {
+          it->second.originTime = latest;
+          updated = true;
+        }
+      }
+      catch (...)
+      {
+        Fmi::Exception::Trace(BCP, "Checking for new data failed!")
+            .addParameter("Producer", producerKey.first)
+            .printError();
+      }
+    }
+
+    if (updated)
+      itsCondition.notify_all();
+  }
+}
+
+}  // namespace Download
+}  // namespace Plugin
+}  // namespace SmartMet
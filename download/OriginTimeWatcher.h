@@ -0,0 +1,89 @@
+// ======================================================================
+/*!
+ * \brief SmartMet download service plugin; waiting for new data
+ */
+// ======================================================================
+
+#pragma once
+
+#include <engines/grid/Engine.h>
+#include <engines/querydata/Engine.h>
+#include <macgyver/DateTime.h>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <utility>
+
+namespace SmartMet
+{
+namespace Plugin
+{
+namespace Download
+{
+// ----------------------------------------------------------------------
+/*!
+ * \brief Waiting for new origintime (model run) of a producer.
+ *
+ *        The latest origintimes of the producers having waiting requests
+ *        are checked periodically in background; querydata from the
+ *        querydata engine and grid data from the content server's
+ *        generation list. The waiting requests are woken up when a new
+ *        origintime is available. The number of waiting requests is
+ *        limited, since each of them occupies a server thread.
+ */
+// ----------------------------------------------------------------------
+
+class OriginTimeWatcher
+{
+ public:
+  OriginTimeWatcher() = default;
+  OriginTimeWatcher(const OriginTimeWatcher &other) = delete;
+  OriginTimeWatcher &operator=(const OriginTimeWatcher &other) = delete;
+  ~OriginTimeWatcher();
+
+  void init(const Engine::Querydata::Engine *qEngine,
+            const Engine::Grid::Engine *gridEngine,
+            unsigned int checkInterval,
+            unsigned int maxWaiters);
+  void shutdown();
+
+  // Waits until origintime later than given origintime is available for the producer or the
+  // timeout expires, and sets origintime to the latest origintime. Returns true if later
+  // origintime was available, or an empty value if too many requests are already waiting
+
+  std::optional<bool> waitForOriginTime(const std::string &producer,
+                         bool gridData,
+                         Fmi::DateTime &originTime,
+                         unsigned int timeout);
+
+ private:
+  using ProducerKey = std::pair<std::string, bool>;  // Producer name and grid data flag
+
+  struct Watch
+  {
+    Fmi::DateTime originTime;  // Latest origintime
+    std::size_t waiters = 0;   // Number of waiting requests
+  };
+
+  Fmi::DateTime latestOriginTime(const ProducerKey &producerKey) const;
+  void run();
+
+  const Engine::Querydata::Engine *itsQEngine = nullptr;
+  const Engine::Grid::Engine *itsGridEngine = nullptr;
+  unsigned int itsCheckInterval = 0;
+  unsigned int itsMaxWaiters = 0;  // Max number of waiting requests in total
+
+  std::mutex itsMutex;
+  std::condition_variable itsCondition;
+  std::map<ProducerKey, Watch> itsWatches;
+  std::size_t itsWaiters = 0;  // Number of waiting requests in total
+  bool itsShutdownFlag = false;
+  std::thread itsThread;
+};
+
+}  // namespace Download
+}  // namespace Plugin
+}  // namespace SmartMet
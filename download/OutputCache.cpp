@@ -0,0 +1,488 @@
+// ======================================================================
+/*!
+ * \brief SmartMet download service plugin; disk cache of outputs shared
+ *        by server processes
+ */
+// ======================================================================
+
+#include "OutputCache.h"
+#include "Tools.h"
+#include <macgyver/Exception.h>
+#include <macgyver/StringConversion.h>
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+namespace
+{
+const char *cacheFileMagic = "DLSCACHE1";
+const std::size_t cachedOutputChunkLength = 2048 * 2048;
+const std::string tmpSuffix = ".tmp";
+
+// Temporary files of abandoned (e.g. crashed) writers are removed after given age
+const auto tmpFileMaxAge = std::chrono::hours(1);
+
+// Max interval of scanning the cache directory when the size limit is not exceeded
+const auto evictInterval = std::chrono::minutes(1);
+
+std::atomic<unsigned long> tmpFileCounter{0};
+
+}  // namespace
+
+using namespace std;
+
+namespace SmartMet
+{
+namespace Plugin
+{
+namespace Download
+{
+// ----------------------------------------------------------------------
+/*!
+ * \brief Map cache file into memory and parse its header.
+ *
+ *		The file consists of a header with magic, request key and output
+ *		file name lines followed by the output. The mapping remains valid
+ *		even if the file is removed while being streamed
+ */
+// ----------------------------------------------------------------------
+
+CachedOutputStreamer::CachedOutputStreamer(const std::string &path)
+    : Spine::HTTP::ContentStreamer()
+{
+  try
+  {
+    int fd = open(path.c_str(), O_RDONLY);
+
+    if (fd < 0)
+      throw Fmi::Exception(BCP, "Unable to open cache file").addParameter("File", path);
+
+    struct stat st;
+
+    if ((fstat(fd, &st) != 0) || (st.st_size == 0))
+    {
+      close(fd);
+      throw Fmi::Exception(BCP, "Invalid cache file").addParameter("File", path);
+    }
+
+    void *data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (data == MAP_FAILED)
+      throw Fmi::Exception(BCP, "Unable to map cache file").addParameter("File", path);
+
+    madvise(data, st.st_size, MADV_SEQUENTIAL);
+
+    itsData = static_cast<const char *>(data);
+    itsMappedSize = st.st_size;
+
+    // Parse the header lines
+
+    string header[3];
+
+    for (auto &line : header)
+    {
+      auto end = static_cast<const char *>(
+          memchr(itsData + itsDataOffset, '\n', itsMappedSize - itsDataOffset));
+
+      if (!end)
+      {
+        munmap(const_cast<char *>(itsData), itsMappedSize);
+        throw Fmi::Exception(BCP, "Invalid cache file header").addParameter("File", path);
+      }
+
+      line = string(itsData + itsDataOffset, end);
+      itsDataOffset = (end - itsData) + 1;
+    }
+
+    if (header[0] != cacheFileMagic)
+    {
+      munmap(const_cast<char *>(itsData), itsMappedSize);
+      throw Fmi::Exception(BCP, "Invalid cache file header").addParameter("File", path);
+    }
+
+    itsRequestKey = header[1];
+    itsFileName = header[2];
+    itsOffset = itsDataOffset;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+CachedOutputStreamer::~CachedOutputStreamer()
+{
+  if (itsData)
+    munmap(const_cast<char *>(itsData), itsMappedSize);
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Get next chunk of the cached output
+ */
+// ----------------------------------------------------------------------
+
+std::string CachedOutputStreamer::getChunk()
+{
+  try
+  {
+    auto length = min(cachedOutputChunkLength, itsMappedSize - itsOffset);
+    string chunk(itsData + itsOffset, length);
+
+    itsOffset += length;
+
+    if (itsOffset >= itsMappedSize)
+      setStatus(ContentStreamer::StreamerStatus::EXIT_OK);
+
+    return chunk;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Store output into a temporary cache file while streaming it
+ */
+// ----------------------------------------------------------------------
+
+CachingStreamer::CachingStreamer(const OutputCache &cache,
+                                 const std::string &requestKey,
+                                 const std::string &fileName,
+                                 const std::shared_ptr<Spine::HTTP::ContentStreamer> &streamer)
+    : Spine::HTTP::ContentStreamer(),
+      itsCache(cache),
+      itsRequestKey(requestKey),
+      itsStreamer(streamer)
+{
+  try
+  {
+    itsTmpPath = itsCache.entryPath(itsRequestKey) + "." + Fmi::to_string(getpid()) + "." +
+                 Fmi::to_string(tmpFileCounter++) + tmpSuffix;
+
+    itsStream.open(itsTmpPath, ios::out | ios::binary | ios::trunc);
+
+    if (itsStream)
+      itsStream << cacheFileMagic << "\n" << itsRequestKey << "\n" << fileName << "\n";
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+CachingStreamer::~CachingStreamer()
+{
+  abandon();
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Remove incomplete cache file
+ */
+// ----------------------------------------------------------------------
+
+void CachingStreamer::abandon()
+{
+  if (itsStream.is_open())
+  {
+    itsStream.close();
+
+    std::error_code ec;
+    std::filesystem::remove(itsTmpPath, ec);
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Get next chunk of data and store it into the cache file.
+ *
+ *		Errors in storing the output do not affect the response
+ */
+// ----------------------------------------------------------------------
+
+std::string CachingStreamer::getChunk()
+{
+  try
+  {
+    auto chunk = itsStreamer->getChunk();
+    auto status = itsStreamer->getStatus();
+
+    try
+    {
+      if (itsStream.is_open())
+      {
+        itsWrittenSize += chunk.size();
+
+        if (status == ContentStreamer::StreamerStatus::EXIT_ERROR)
+          abandon();
+        else if (!itsCache.cacheable(itsWrittenSize))
+          abandon();
+        else if (!itsStream.write(chunk.data(), chunk.size()))
+          abandon();
+        else if (status == ContentStreamer::StreamerStatus::EXIT_OK)
+        {
+          itsStream.close();
+
+          if (itsStream.fail())
+          {
+            std::error_code ec;
+            std::filesystem::remove(itsTmpPath, ec);
+          }
+          else
+            itsCache.insert(itsTmpPath, itsRequestKey);
+        }
+      }
+    }
+    catch (...)
+    {
+      Fmi::Exception::Trace(BCP, "Storing output into cache failed!").printError();
+      abandon();
+    }
+
+    if (status != ContentStreamer::StreamerStatus::OK)
+      setStatus(status);
+
+    return chunk;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Initialize the cache
+ */
+// ----------------------------------------------------------------------
+
+void OutputCache::init(const std::string &directory,
+                       std::size_t maxSize,
+                       std::size_t maxEntrySize)
+{
+  try
+  {
+    itsDirectory = directory;
+    itsMaxSize = maxSize;
+    itsMaxEntrySize = maxEntrySize;
+
+    if (!enabled())
+      return;
+
+    std::filesystem::create_directories(itsDirectory);
+
+    // Get the initial cache size
+
+    evict();
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Get cache file path for given request key
+ */
+// ----------------------------------------------------------------------
+
+std::string OutputCache::entryPath(const std::string &requestKey) const
+{
+  // The directory can be shared by multiple server processes (and builds); the file name must
+  // not depend on the build
+
+  return itsDirectory + "/" + getDigest(requestKey);
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Get cached output.
+ *
+ *		The request key stored in the file is checked to detect hash
+ *		collisions. The file's modification time is updated for LRU
+ *		eviction
+ */
+// ----------------------------------------------------------------------
+
+std::shared_ptr<CachedOutputStreamer> OutputCache::find(const std::string &requestKey) const
+{
+  auto path = entryPath(requestKey);
+
+  try
+  {
+    if (!std::filesystem::exists(path))
+      return nullptr;
+
+    auto streamer = std::make_shared<CachedOutputStreamer>(path);
+
+    if (streamer->getRequestKey() != requestKey)
+      return nullptr;
+
+    std::error_code ec;
+    std::filesystem::last_write_time(path, std::filesystem::file_time_type::clock::now(), ec);
+
+    return streamer;
+  }
+  catch (...)
+  {
+    // The file may have been evicted or replaced by another process
+
+    return nullptr;
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Return streamer storing the output into the cache
+ */
+// ----------------------------------------------------------------------
+
+std::shared_ptr<Spine::HTTP::ContentStreamer> OutputCache::store(
+    const std::string &requestKey,
+    const std::string &fileName,
+    const std::shared_ptr<Spine::HTTP::ContentStreamer> &streamer) const
+{
+  try
+  {
+    return std::make_shared<CachingStreamer>(*this, requestKey, fileName, streamer);
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Move completed cache file into its place and evict old entries.
+ *
+ *		The directory is scanned only if the tracked cache size exceeds
+ *		the limit or the previous scan is old enough
+ */
+// ----------------------------------------------------------------------
+
+void OutputCache::insert(const std::string &tmpPath, const std::string &requestKey) const
+{
+  try
+  {
+    auto size = std::filesystem::file_size(tmpPath);
+
+    std::filesystem::rename(tmpPath, entryPath(requestKey));
+
+    auto cacheSize = (itsSize += size);
+    bool scan = ((itsMaxSize > 0) && (cacheSize > itsMaxSize));
+
+    if (!scan)
+    {
+      // If the lock is not available, the directory is being scanned
+
+      std::unique_lock<std::mutex> lock(itsEvictMutex, std::try_to_lock);
+      scan = (lock.owns_lock() &&
+              ((std::chrono::steady_clock::now() - itsLastEviction) >= evictInterval));
+    }
+
+    if (scan)
+      evict();
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Remove least recently used entries if the cache size limit is exceeded.
+ *
+ *		Temporary files are removed only if they have been abandoned.
+ *		If another thread is already scanning the directory, returns
+ *		immediately
+ */
+// ----------------------------------------------------------------------
+
+void OutputCache::evict() const
+{
+  try
+  {
+    std::unique_lock<std::mutex> lock(itsEvictMutex, std::try_to_lock);
+
+    if (!lock.owns_lock())
+      return;
+
+    itsLastEviction = std::chrono::steady_clock::now();
+
+    using Entry = std::pair<std::filesystem::file_time_type, std::filesystem::path>;
+
+    std::vector<Entry> entries;
+    std::vector<std::size_t> sizes;
+    std::size_t cacheSize = 0;
+    std::error_code ec;
+    auto now = std::filesystem::file_time_type::clock::now();
+
+    for (auto const &file : std::filesystem::directory_iterator(itsDirectory, ec))
+    {
+      auto mtime = file.last_write_time(ec);
+      auto size = file.file_size(ec);
+
+      if (ec)
+        continue;
+
+      if (file.path().string().find(tmpSuffix) != string::npos)
+      {
+        if ((now - mtime) > tmpFileMaxAge)
+          std::filesystem::remove(file.path(), ec);
+
+        continue;
+      }
+
+      cacheSize += size;
+      entries.push_back(Entry(mtime, file.path()));
+      sizes.push_back(size);
+    }
+
+    if ((itsMaxSize == 0) || (cacheSize <= itsMaxSize))
+    {
+      itsSize = cacheSize;
+      return;
+    }
+
+    std::vector<std::size_t> order(entries.size());
+
+    for (std::size_t i = 0; (i < order.size()); i++)
+      order[i] = i;
+
+    std::sort(order.begin(),
+              order.end(),
+              [&entries](std::size_t a, std::size_t b) { return entries[a].first < entries[b].first; });
+
+    for (auto i : order)
+    {
+      if (cacheSize <= itsMaxSize)
+        break;
+
+      if (std::filesystem::remove(entries[i].second, ec))
+        cacheSize -= sizes[i];
+    }
+
+    itsSize = cacheSize;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+}  // namespace Download
+}  // namespace Plugin
+}  // namespace SmartMet
@@ -0,0 +1,148 @@
+// ======================================================================
+/*!
+ * \brief SmartMet download service plugin; disk cache of outputs shared
+ *        by server processes
+ */
+// ======================================================================
+
+#pragma once
+
+#include <spine/HTTP.h>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace SmartMet
+{
+namespace Plugin
+{
+namespace Download
+{
+// ----------------------------------------------------------------------
+/*!
+ * \brief Return cached output from memory mapped cache file
+ */
+// ----------------------------------------------------------------------
+
+class CachedOutputStreamer : public Spine::HTTP::ContentStreamer
+{
+ public:
+  CachedOutputStreamer(const std::string &path);
+  virtual ~CachedOutputStreamer();
+
+  virtual std::string getChunk();
+
+  const std::string &getRequestKey() const { return itsRequestKey; }
+  const std::string &getFileName() const { return itsFileName; }
+  std::size_t getOutputSize() const { return itsMappedSize - itsDataOffset; }
+
+ private:
+  CachedOutputStreamer();
+
+  const char *itsData = nullptr;
+  std::size_t itsMappedSize = 0;
+  std::size_t itsDataOffset = 0;  // Start of the output (end of cache file header)
+  std::size_t itsOffset = 0;      // Offset of the next chunk
+
+  std::string itsRequestKey;
+  std::string itsFileName;
+};
+
+class OutputCache;
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Store output into the cache while streaming it
+ */
+// ----------------------------------------------------------------------
+
+class CachingStreamer : public Spine::HTTP::ContentStreamer
+{
+ public:
+  CachingStreamer(const OutputCache &cache,
+                  const std::string &requestKey,
+                  const std::string &fileName,
+                  const std::shared_ptr<Spine::HTTP::ContentStreamer> &streamer);
+  virtual ~CachingStreamer();
+
+  virtual std::string getChunk();
+
+ private:
+  CachingStreamer();
+
+  void abandon();
+
+  const OutputCache &itsCache;
+  std::string itsRequestKey;
+  std::shared_ptr<Spine::HTTP::ContentStreamer> itsStreamer;
+  std::string itsTmpPath;
+  std::ofstream itsStream;
+  std::size_t itsWrittenSize = 0;  // Size of the output written so far
+};
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Disk cache of outputs.
+ *
+ *        Outputs are stored by request key (normalized request and data
+ *        version) into the cache directory, which can be shared by
+ *        multiple server processes. The entries are written into temporary
+ *        files and renamed when complete. Outputs larger than the entry
+ *        size limit are not cached. The cache size is tracked as entries
+ *        are added, and the directory is scanned to remove least recently
+ *        used entries when the size limit is exceeded or periodically
+ *        (to account for the entries of other processes).
+ */
+// ----------------------------------------------------------------------
+
+class OutputCache
+{
+ public:
+  OutputCache() = default;
+  OutputCache(const OutputCache &other) = delete;
+  OutputCache &operator=(const OutputCache &other) = delete;
+
+  void init(const std::string &directory, std::size_t maxSize, std::size_t maxEntrySize);
+
+  bool enabled() const { return (!itsDirectory.empty()); }
+
+  // Returns false if output of given size is too large to be cached
+
+  bool cacheable(std::size_t outputSize) const
+  {
+    return ((itsMaxEntrySize == 0) || (outputSize <= itsMaxEntrySize));
+  }
+
+  // Returns cached output or nullptr if not cached
+
+  std::shared_ptr<CachedOutputStreamer> find(const std::string &requestKey) const;
+
+  // Returns streamer storing the output into the cache
+
+  std::shared_ptr<Spine::HTTP::ContentStreamer> store(
+      const std::string &requestKey,
+      const std::string &fileName,
+      const std::shared_ptr<Spine::HTTP::ContentStreamer> &streamer) const;
+
+ private:
+  friend class CachingStreamer;
+
+  std::string entryPath(const std::string &requestKey) const;
+  void insert(const std::string &tmpPath, const std::string &requestKey) const;
+  void evict() const;
+
+  std::string itsDirectory;  // If empty, the cache is disabled
+  std::size_t itsMaxSize = 0;
+  std::size_t itsMaxEntrySize = 0;  // If 0, no limit
+
+  mutable std::mutex itsEvictMutex;                               // Serializes directory scans
+  mutable std::atomic<std::size_t> itsSize{0};                    // Size at last scan + added
+  mutable std::chrono::steady_clock::time_point itsLastEviction;  // Time of last scan
+};
+
+}  // namespace Download
+}  // namespace Plugin
+}  // namespace SmartMet
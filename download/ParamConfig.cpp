@@ -60,6 +60,8 @@ ParamChangeItem::ParamChangeItem(const ParamChangeItem& theOther)
       itsLongName(theOther.itsLongName),
       itsCentre(theOther.itsCentre),
       itsTemplateNumber(theOther.itsTemplateNumber),
+      itsPrecision(theOther.itsPrecision),
+      itsSignificantBits(theOther.itsSignificantBits),
       itsGridRelative(theOther.itsGridRelative),
       itsRadonProducer(theOther.itsRadonProducer),
       itsRadonName(theOther.itsRadonName),
@@ -86,6 +88,8 @@ ParamChangeItem& ParamChangeItem::operator=(const ParamChangeItem& theOther)
       itsLongName = theOther.itsLongName;
       itsCentre = theOther.itsCentre;
       itsTemplateNumber = theOther.itsTemplateNumber;
+      itsPrecision = theOther.itsPrecision;
+      itsSignificantBits = theOther.itsSignificantBits;
       itsGridRelative = theOther.itsGridRelative;
       itsRadonProducer = theOther.itsRadonProducer;
       itsRadonName = theOther.itsRadonName;
@@ -372,6 +376,18 @@ bool readNetCdfParamConfigField(const std::string& name,
     else if (name == "gridrelative")
       // Nonzero (true) when U and V are relative to the grid
       p.itsGridRelative = (asUInt(name, json, arrayIndex) > 0);
+    else if (name == "significantbits")
+    {
+      // Number of mantissa bits retained when bit-rounding the values, 1-23
+      auto bits = asUInt(name, json, arrayIndex);
+
+      if ((bits < 1) || (bits > 23))
+        throw Fmi::Exception(BCP,
+                             "'" + name + "': value in range 1-23 expected at array index " +
+                                 Fmi::to_string(arrayIndex));
+
+      p.itsSignificantBits = bits;
+    }
     else
       // Unknown setting
       //
@@ -388,6 +404,63 @@ bool readNetCdfParamConfigField(const std::string& name,
   }
 }
 
+// ======================================================================
+/*!
+ * \brief Add parameter configuration item and its lookup indexes
+ */
+// ======================================================================
+
+void ParamChangeTable::push_back(const ParamChangeItem &item)
+{
+  try
+  {
+    std::size_t idx = itsItems.size();
+
+    itsItems.push_back(item);
+
+    itsParamIdIndexes[item.itsWantedParam.GetIdent()].push_back(idx);
+
+    if (!item.itsRadonName.empty())
+      itsRadonNameIndexes[item.itsRadonName].push_back(idx);
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ======================================================================
+/*!
+ * \brief Get table indexes of the entries for given newbase parameter id
+ */
+// ======================================================================
+
+const ParamChangeTable::Indexes &ParamChangeTable::getIndexesByParamId(
+    unsigned long paramId) const
+{
+  static const Indexes noIndexes;
+
+  auto it = itsParamIdIndexes.find(paramId);
+
+  return ((it != itsParamIdIndexes.end()) ? it->second : noIndexes);
+}
+
+// ======================================================================
+/*!
+ * \brief Get table indexes of the entries for given radon parameter name
+ */
+// ======================================================================
+
+const ParamChangeTable::Indexes &ParamChangeTable::getIndexesByRadonName(
+    const std::string &radonName) const
+{
+  static const Indexes noIndexes;
+
+  auto it = itsRadonNameIndexes.find(radonName);
+
+  return ((it != itsRadonNameIndexes.end()) ? it->second : noIndexes);
+}
+
 // ======================================================================
 /*!
  * \brief Load parameter configuration.
@@ -403,7 +476,7 @@ ParamChangeTable readParamConfig(const std::filesystem::path& configFilePath, bo
     Json::CharReaderBuilder charReaderBuilder;
     std::unique_ptr<Json::CharReader> reader(charReaderBuilder.newCharReader());
     Json::Value theJson;
-    std::vector<ParamChangeItem> paramChangeTable;
+    ParamChangeTable paramChangeTable;
 
     std::ifstream in(configFilePath.c_str());
     if (!in)
@@ -471,6 +544,15 @@ ParamChangeTable readParamConfig(const std::filesystem::path& configFilePath, bo
           p.itsStepType = asString(name, json, i);
         else if (name == "aggregatelength")
           p.itsPeriodLengthMinutes = asUInt(name, json, i);
+        else if (name == "precision")
+        {
+          if ((!json.isNumeric()) || (json.asFloat() <= 0))
+            throw Fmi::Exception(BCP,
+                                 "'" + name + "': positive value expected at array index " +
+                                     Fmi::to_string(i));
+
+          p.itsPrecision = json.asFloat();
+        }
         //
         // Handle format specific settings
         //
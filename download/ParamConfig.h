@@ -13,6 +13,7 @@
 #include <optional>
 
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 namespace SmartMet
@@ -60,6 +61,8 @@ struct ParamChangeItem
   std::string itsLongName;              // Long name for netcdf parameters
   std::string itsCentre;                // Originating centre for grib parameters
   std::optional<long> itsTemplateNumber;  // 'productDefinitionTemplateNumber' for grib parameters
+  std::optional<float> itsPrecision;      // Required absolute precision of output values
+  std::optional<unsigned int> itsSignificantBits;  // Netcdf bit-rounding mantissa bits
 
   std::optional<bool> itsGridRelative;// Set for grid relative U and V
 
@@ -71,7 +74,33 @@ struct ParamChangeItem
   GribParamId itsGrib2Param;     // Grib2 discipline etc
 };
 
-typedef std::vector<ParamChangeItem> ParamChangeTable;
+// Parameter configuration table with lookup indexes by newbase parameter id and by radon
+// parameter name. Items can only be appended to the table, and the indexes are updated when
+// an item is added; existing items can not be modified
+
+class ParamChangeTable
+{
+ public:
+  typedef std::vector<ParamChangeItem> Items;
+  typedef std::vector<std::size_t> Indexes;  // Table indexes in table order
+
+  void push_back(const ParamChangeItem &item);
+
+  std::size_t size() const { return itsItems.size(); }
+  bool empty() const { return itsItems.empty(); }
+  const ParamChangeItem &operator[](std::size_t idx) const { return itsItems[idx]; }
+  Items::const_iterator begin() const { return itsItems.begin(); }
+  Items::const_iterator end() const { return itsItems.end(); }
+
+  const Indexes &getIndexesByParamId(unsigned long paramId) const;
+  const Indexes &getIndexesByRadonName(const std::string &radonName) const;
+
+ private:
+  Items itsItems;
+  std::unordered_map<unsigned long, Indexes> itsParamIdIndexes;
+  std::unordered_map<std::string, Indexes> itsRadonNameIndexes;
+};
+
 ParamChangeTable readParamConfig(const std::filesystem::path &configFilePath, bool grib = true);
 
 }  // namespace Download
@@ -9,6 +9,7 @@
 // ======================================================================
 
 #include "Plugin.h"
+#include "DataStreamer.h"
 #include <boost/bind/bind.hpp>
 #include <macgyver/Exception.h>
 #include <spine/SmartMet.h>
@@ -39,6 +40,22 @@ void Plugin::requestHandler(Spine::Reactor &theReactor,
   itsDownloadHandler.requestHandler(theReactor, theRequest, theResponse);
 }
 
+// ----------------------------------------------------------------------
+/*!
+ * \brief Content handler for /download/origintime
+ *
+ *        Delegates to DownloadHandler which waits for new origintime
+ *        of the requested producer.
+ */
+// ----------------------------------------------------------------------
+
+void Plugin::originTimeRequestHandler(Spine::Reactor &theReactor,
+                                      const Spine::HTTP::Request &theRequest,
+                                      Spine::HTTP::Response &theResponse)
+{
+  itsDownloadHandler.originTimeRequestHandler(theReactor, theRequest, theResponse);
+}
+
 // ----------------------------------------------------------------------
 /*!
  * \brief Content handler for /coverages
@@ -106,8 +123,59 @@ void Plugin::init()
 
     /* Initialize handlers */
 
-    itsDownloadHandler.init(itsConfig, itsQEngine.get(), itsGridEngine.get(), itsGeoEngine.get());
-    itsCoveragesHandler.init(itsConfig, itsQEngine.get(), itsGridEngine.get(), itsGeoEngine.get());
+    itsAdmissionControl.init(itsConfig.getMaxConcurrentCost(),
+                             itsConfig.getAdmissionDefaultCost(),
+                             itsConfig.getAdmissionMaxQueued(),
+                             itsConfig.getAdmissionQueueTimeout());
+
+    itsSharedStreams.init(itsConfig.getSharedStreamBufferSize());
+
+    itsOutputCache.init(itsConfig.getOutputCacheDirectory(),
+                        itsConfig.getOutputCacheMaxSize(),
+                        itsConfig.getOutputCacheMaxEntrySize());
+
+    itsCoordinateCache.init(itsConfig.getCoordinateCacheMaxSize());
+
+    if (itsConfig.getNetCdfExtractionThreads() > 1)
+      itsExtractionPool.init(itsConfig.getNetCdfExtractionThreads());
+
+    itsMessageIndex.init(itsConfig.getMessageIndexSize());
+
+    itsOriginTimeWatcher.init(itsQEngine.get(),
+                              itsGridEngine.get(),
+                              itsConfig.getOriginTimeWaitCheckInterval(),
+                              itsConfig.getOriginTimeWaitMaxWaiters());
+
+    itsDownloadHandler.init(itsConfig,
+                            itsAdmissionControl,
+                            itsSharedStreams,
+                            itsHotProducts,
+                            itsOutputCache,
+                            itsOriginTimeWatcher,
+                            itsCoordinateCache,
+                            itsExtractionPool,
+                            itsMessageIndex,
+                            itsQEngine.get(),
+                            itsGridEngine.get(),
+                            itsGeoEngine.get());
+    itsCoveragesHandler.init(itsConfig,
+                             itsAdmissionControl,
+                             itsCoordinateCache,
+                             itsExtractionPool,
+                             itsQEngine.get(),
+                             itsGridEngine.get(),
+                             itsGeoEngine.get());
+
+    /* Start pregeneration of configured products */
+
+    itsHotProducts.init(
+        itsConfig,
+        [this](const Spine::HTTP::Request &theRequest)
+        { return itsDownloadHandler.getProductKey(theRequest); },
+        [this](const Spine::HTTP::Request &theRequest,
+               std::string &filename,
+               std::string &requestKey)
+        { return itsDownloadHandler.createProductStreamer(theRequest, filename, requestKey); });
 
     /* Register content handlers for both API paths */
 
@@ -117,6 +185,12 @@ void Plugin::init()
             boost::bind(&Plugin::callRequestHandler, this, ph::_1, ph::_2, ph::_3)))
       throw Fmi::Exception(BCP, "Failed to register download content handler");
 
+    if (!itsReactor->addContentHandler(
+            this,
+            "/download/origintime",
+            boost::bind(&Plugin::originTimeRequestHandler, this, ph::_1, ph::_2, ph::_3)))
+      throw Fmi::Exception(BCP, "Failed to register origintime content handler");
+
     if (!itsReactor->addContentHandler(
             this,
             "/coverages",
@@ -140,6 +214,11 @@ void Plugin::init()
 void Plugin::shutdown()
 {
   std::cout << "  -- Shutdown requested (dls)\n";
+
+  DataStreamer::cancelAll();
+  itsExtractionPool.shutdown();
+  itsHotProducts.shutdown();
+  itsOriginTimeWatcher.shutdown();
 }
 
 // ----------------------------------------------------------------------
@@ -175,12 +254,22 @@ int Plugin::getRequiredAPIVersion() const
 // ----------------------------------------------------------------------
 /*!
  * \brief Performance query implementation.
+ *
+ *        Small /download requests are classified as fast based on cheap
+ *        estimation of their cost; /coverages and (long polling)
+ *        /download/origintime requests are always slow.
  */
 // ----------------------------------------------------------------------
 
-bool Plugin::queryIsFast(const Spine::HTTP::Request & /* theRequest */) const
+bool Plugin::queryIsFast(const Spine::HTTP::Request &theRequest) const
 {
-  return false;
+  const auto &resource = theRequest.getResource();
+
+  if ((resource.find("/coverages") != std::string::npos) ||
+      (resource.find("/download/origintime") != std::string::npos))
+    return false;
+
+  return itsDownloadHandler.queryIsFast(theRequest);
 }
 
 }  // namespace Download
@@ -11,6 +11,14 @@
 #pragma once
 
 #include "Config.h"
+#include "CoordinateCache.h"
+#include "ExtractionPool.h"
+#include "HotProducts.h"
+#include "MessageIndex.h"
+#include "OriginTimeWatcher.h"
+#include "OutputCache.h"
+#include "RequestCost.h"
+#include "SharedStreamer.h"
 #include "download/Handler.h"
 #include "coverages/Handler.h"
 #include <memory>
@@ -53,8 +61,19 @@ class Plugin : public SmartMetPlugin
                                const Spine::HTTP::Request& theRequest,
                                Spine::HTTP::Response& theResponse);
 
+  void originTimeRequestHandler(Spine::Reactor& theReactor,
+                                const Spine::HTTP::Request& theRequest,
+                                Spine::HTTP::Response& theResponse);
+
   const std::string itsModuleName;
   Config itsConfig;
+  AdmissionControl itsAdmissionControl;
+  SharedStreams itsSharedStreams;
+  OutputCache itsOutputCache;
+  CoordinateCache itsCoordinateCache;
+  ExtractionPool itsExtractionPool;
+  MessageIndex itsMessageIndex;
+  OriginTimeWatcher itsOriginTimeWatcher;
 
   Spine::Reactor* itsReactor;
   std::shared_ptr<Engine::Querydata::Engine> itsQEngine;
@@ -63,6 +82,10 @@ class Plugin : public SmartMetPlugin
 
   DownloadHandler itsDownloadHandler;
   CoveragesHandler itsCoveragesHandler;
+
+  // Uses the download handler and engines for generating the products; must be destroyed first
+
+  HotProducts itsHotProducts;
 };
 
 }  // namespace Download
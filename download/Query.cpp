@@ -188,6 +188,46 @@ bool Query::parseRadonParameterName(
   return (!funcParamDef.empty());
 }
 
+// ----------------------------------------------------------------------
+/*!
+ * \brief Get parsed radon parameter name.
+ *
+ *		The name is parsed once and the parsed parts are converted to
+ *		numeric values to avoid repeated parsing when processing each grid
+ */
+// ----------------------------------------------------------------------
+
+const RadonParameter &Query::getRadonParameter(const string &param) const
+{
+  try
+  {
+    auto it = parsedRadonParameters.find(param);
+
+    if (it != parsedRadonParameters.end())
+      return it->second;
+
+    vector<string> paramParts;
+    parseRadonParameterName(param, paramParts);
+
+    RadonParameter radonParameter;
+
+    radonParameter.name = paramParts[0];
+    radonParameter.producer = paramParts[1];
+    radonParameter.geometryId = getGeometryId(param, paramParts);
+    radonParameter.levelTypeId = getParamLevelId(param, paramParts);
+    radonParameter.level = getParamLevel(param, paramParts);
+    radonParameter.forecastType = getForecastType(param, paramParts);
+    radonParameter.forecastNumber = getForecastNumber(param, paramParts);
+    radonParameter.functionParam = isFunctionParameter(param);
+
+    return parsedRadonParameters.insert(make_pair(param, radonParameter)).first->second;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
 // ----------------------------------------------------------------------
 /*!
  * \brief Parse int value
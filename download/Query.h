@@ -63,6 +63,9 @@ struct Producer
 
   bool multiFile;  // If set, query can span over multiple grid origintimes
 
+  std::map<std::string, int> compressionLevels;  // Compression levels by "format.encoding"
+                                                 // overriding the global settings
+
   Producer() : verticalInterpolation(false), multiFile(false) {}
 
   bool disabledReqParam(std::string param) const
@@ -230,6 +233,10 @@ struct ReqParams
   unsigned int grib2TablesVersion;  // If given (nonzero), set as grib2
                                     // 'gribMasterTablesVersionNumber'
   //
+  // Number of significant (mantissa) bits retained when bit-rounding netcdf values
+  //
+  int significantBits = -1;  // 1-23, default -1 for using parameter configuration
+  //
   // Datum handling. Default: native datum (no shift)
   //
   std::string datum;                               // DatumShift value; see Datum.h
@@ -243,6 +250,24 @@ struct ReqParams
   ReqParams() {}
 };
 
+// ----------------------------------------------------------------------
+/*!
+ * \brief Parsed radon parameter name, e.g. T-K:MEPS:1093:6:2:1:0
+ */
+// ----------------------------------------------------------------------
+
+struct RadonParameter
+{
+  std::string name;
+  std::string producer;
+  T::GeometryId geometryId = 0;
+  T::ParamLevelId levelTypeId = 0;
+  T::ParamLevel level = 0;
+  T::ForecastType forecastType = 0;
+  T::ForecastNumber forecastNumber = -1;
+  bool functionParam = false;  // Result of a grid function
+};
+
 class Query
 {
  public:
@@ -264,6 +289,7 @@ class Query
   bool parseRadonParameterName(
       const std::string &paramDef, std::vector<std::string> &paramParts, std::string &param,
       std::string &funcParamDef) const;
+  const RadonParameter &getRadonParameter(const std::string &param) const;
   bool isFunctionParameter(const std::string &param) const;
   bool isFunctionParameter(const std::string &param, std::string &funcParamDef) const;
   bool isFunctionParameter(
@@ -279,6 +305,7 @@ class Query
   Query();
 
   std::map<std::string, std::vector<std::string>> radonParameters;
+  mutable std::map<std::string, RadonParameter> parsedRadonParameters;
   std::map<std::string, std::string> functionParameters;
   GenerationInfos generationInfos;
   ParameterContents parameterContents;
@@ -32,6 +32,144 @@ QDStreamer::QDStreamer(const Spine::HTTP::Request &req,
 
 QDStreamer::~QDStreamer() {}
 
+// ----------------------------------------------------------------------
+/*!
+ * \brief Return the source querydata file as is.
+ *
+ *		Used when the request does not need any subsetting or reprojection.
+ *		The file is opened immediately to keep it accessible even if the
+ *		querydata engine removes it while the data is being streamed
+ *
+ */
+// ----------------------------------------------------------------------
+
+void QDStreamer::setPassThrough(const std::string &fileName)
+{
+  try
+  {
+    itsPassThroughStream.open(fileName, std::ios::binary | std::ios::in);
+
+    if (!itsPassThroughStream)
+      throw Fmi::Exception(BCP, "Unable to open querydata file").addParameter("File", fileName);
+
+    itsPassThroughStream.seekg(0, std::ios::end);
+    itsPassThroughSize = itsPassThroughStream.tellg();
+    itsPassThroughStream.seekg(0, std::ios::beg);
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Skip given number of bytes when returning the source querydata file
+ *
+ */
+// ----------------------------------------------------------------------
+
+std::size_t QDStreamer::skipBytes(std::size_t nBytes)
+{
+  try
+  {
+    if ((!itsPassThroughStream.is_open()) || (nBytes > itsPassThroughSize))
+      return 0;
+
+    itsPassThroughStream.seekg(nBytes, std::ios::beg);
+
+    return nBytes;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Return output size if known (when returning the source querydata file)
+ *
+ */
+// ----------------------------------------------------------------------
+
+std::optional<std::size_t> QDStreamer::getOutputSize() const
+{
+  if (itsPassThroughStream.is_open())
+    return itsPassThroughSize;
+
+  return std::nullopt;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Get next chunk of the source querydata file
+ *
+ */
+// ----------------------------------------------------------------------
+
+std::string QDStreamer::getPassThroughChunk()
+{
+  try
+  {
+    string chunk(itsChunkLength, '\0');
+
+    itsPassThroughStream.read(&chunk[0], itsChunkLength);
+    chunk.resize(itsPassThroughStream.gcount());
+
+    if (itsPassThroughStream.bad())
+      throw Fmi::Exception(BCP, "Error reading querydata file");
+
+    if (itsPassThroughStream.eof())
+    {
+      itsPassThroughStream.close();
+      itsDoneFlag = true;
+
+      setStatus(ContentStreamer::StreamerStatus::EXIT_OK);
+    }
+
+    return chunk;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Get querydata headers/metadata
+ *
+ */
+// ----------------------------------------------------------------------
+
+std::string QDStreamer::getMetaData() const
+{
+  try
+  {
+    ostringstream os;
+
+    os << *(itsQueryData->Info());
+
+    // "Backward compatibility when other than floats were supported"
+
+    const int kFloat = 6;
+    os << kFloat << endl;
+
+    //			if (FmiInfoVersion >= 6)
+    //				os << itsSaveAsBinaryFlag << endl;
+    os << true << endl;
+
+    os << itsQueryData->Info()->Size() * sizeof(itsGridValues[0][0]) << endl;
+
+    return os.str();
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
 // ----------------------------------------------------------------------
 /*!
  * \brief Get next chunk of data. Called from SmartMet server code
@@ -45,6 +183,18 @@ std::string QDStreamer::getChunk()
   {
     try
     {
+      if (itsPassThroughStream.is_open())
+        return getPassThroughChunk();
+
+      if (itsMetaFlag && (itsCfg.getChunkTimeBudget() > 0))
+      {
+        // Loading parameter's data may take long; when limiting chunk generation time, send
+        // querydata headers/metadata first to get the data flowing to the client
+        //
+        itsMetaFlag = false;
+        return getMetaData();
+      }
+
       if (itsDoneFlag && (!itsLoadedFlag))
       {
         setStatus(ContentStreamer::StreamerStatus::EXIT_OK);
@@ -100,20 +250,9 @@ std::string QDStreamer::getChunk()
       {
         // Send querydata headers/metadata
         //
-        os << *(itsQueryData->Info());
+        os << getMetaData();
         itsMetaFlag = false;
 
-        // "Backward compatibility when other than floats were supported"
-
-        const int kFloat = 6;
-        os << kFloat << endl;
-
-        //			if (FmiInfoVersion >= 6)
-        //				os << itsSaveAsBinaryFlag << endl;
-        os << true << endl;
-
-        os << itsQueryData->Info()->Size() * valueSize << endl;
-
         chunkLen = os.tellp();
       }
 
@@ -154,10 +293,15 @@ std::string QDStreamer::getChunk()
     }
     catch (...)
     {
-      Fmi::Exception exception(BCP, "Request processing exception!", nullptr);
-      exception.addParameter("URI", itsRequest.getURI());
+      // Cancellation has already been logged
 
-      std::cerr << exception.getStackTrace();
+      if (!isCancelled())
+      {
+        Fmi::Exception exception(BCP, "Request processing exception!", nullptr);
+        exception.addParameter("URI", itsRequest.getURI());
+
+        std::cerr << exception.getStackTrace();
+      }
     }
 
     setStatus(ContentStreamer::StreamerStatus::EXIT_ERROR);
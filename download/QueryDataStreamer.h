@@ -7,6 +7,7 @@
 #pragma once
 
 #include "DataStreamer.h"
+#include <fstream>
 
 namespace SmartMet
 {
@@ -23,6 +24,12 @@ class QDStreamer : public DataStreamer
 
   virtual std::string getChunk();
 
+  void setPassThrough(const std::string& fileName);
+
+  virtual std::size_t skipBytes(std::size_t nBytes);
+  virtual std::optional<std::size_t> getOutputSize() const;
+  virtual std::size_t getSkippableSize() const { return getOutputSize().value_or(0); }
+
   virtual void getDataChunk(Engine::Querydata::Q q,
                             const NFmiArea* area,
                             NFmiGrid* grid,
@@ -34,12 +41,18 @@ class QDStreamer : public DataStreamer
  private:
   QDStreamer();
 
+  std::string getPassThroughChunk();
+  std::string getMetaData() const;
+
   std::list<NFmiDataMatrix<float>> itsGrids;  // Stores all loaded data/grids for current parameter
   bool itsMetaFlag = true;     // If set, send querydata headers (loading the first chunk)
   bool itsLoadedFlag = false;  // If set, all data has been loaded (but possibly not sent yet)
 
   std::size_t itsCurrentX = 0;  // Current column and row; the grid cell to start the next chunk
   std::size_t itsCurrentY = 0;
+
+  std::ifstream itsPassThroughStream;  // If open, the source querydata file is returned as is
+  std::size_t itsPassThroughSize = 0;  // Source querydata file size
 };
 
 }  // namespace Download
@@ -0,0 +1,162 @@
+// ======================================================================
+/*!
+ * \brief SmartMet download service plugin; byte range streaming
+ */
+// ======================================================================
+
+#include "RangeStreamer.h"
+#include <boost/algorithm/string/predicate.hpp>
+#include <macgyver/Exception.h>
+#include <macgyver/StringConversion.h>
+
+using namespace std;
+
+namespace SmartMet
+{
+namespace Plugin
+{
+namespace Download
+{
+// ----------------------------------------------------------------------
+/*!
+ * \brief Parse single byte range from Range header
+ */
+// ----------------------------------------------------------------------
+
+std::optional<ByteRange> parseByteRange(const std::string &rangeHeader)
+{
+  try
+  {
+    const string unit = "bytes=";
+
+    if (!boost::algorithm::starts_with(rangeHeader, unit))
+      return std::nullopt;
+
+    string range = rangeHeader.substr(unit.length());
+    auto pos = range.find('-');
+
+    if ((pos == 0) || (pos == string::npos) || (range.find(',') != string::npos))
+      return std::nullopt;
+
+    try
+    {
+      ByteRange byteRange;
+      string last = range.substr(pos + 1);
+
+      byteRange.first = Fmi::stoul(range.substr(0, pos));
+
+      if (!last.empty())
+      {
+        byteRange.last = Fmi::stoul(last);
+
+        if (*byteRange.last < byteRange.first)
+          return std::nullopt;
+      }
+
+      return byteRange;
+    }
+    catch (...)
+    {
+    }
+
+    return std::nullopt;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+RangeStreamer::RangeStreamer(const std::shared_ptr<DataStreamer> &streamer,
+                             const ByteRange &range)
+    : Spine::HTTP::ContentStreamer(),
+      itsStreamer(streamer),
+      itsFirst(range.first),
+      itsLast(range.last)
+{
+}
+
+RangeStreamer::~RangeStreamer() {}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Get next chunk of data. Called from SmartMet server code
+ */
+// ----------------------------------------------------------------------
+
+std::string RangeStreamer::getChunk()
+{
+  try
+  {
+    return readChunk();
+  }
+  catch (...)
+  {
+    setStatus(ContentStreamer::StreamerStatus::EXIT_ERROR);
+
+    Fmi::Exception exception(BCP, "Request processing exception!", nullptr);
+    std::cerr << exception.getStackTrace();
+
+    return "";
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Get next chunk of the range.
+ *
+ *		Data preceding the range is skipped by the streamer if it can do
+ *		it without generating the data (e.g. by skipping whole grib
+ *		messages); the rest is generated and discarded
+ */
+// ----------------------------------------------------------------------
+
+std::string RangeStreamer::readChunk()
+{
+  try
+  {
+    if (!itsSkipped)
+    {
+      itsOffset = itsStreamer->skipBytes(itsFirst);
+      itsSkipped = true;
+    }
+
+    while (true)
+    {
+      string chunk = itsStreamer->getChunk();
+      auto status = itsStreamer->getStatus();
+
+      // Range of the chunk within the output, and the part of it to return
+
+      std::size_t chunkFirst = itsOffset;
+      std::size_t chunkEnd = itsOffset + chunk.length();
+
+      itsOffset = chunkEnd;
+
+      std::size_t first = max(chunkFirst, itsFirst);
+      std::size_t end = (itsLast ? min(chunkEnd, *itsLast + 1) : chunkEnd);
+
+      if (first < end)
+        chunk = chunk.substr(first - chunkFirst, end - first);
+      else
+        chunk.clear();
+
+      if (status != ContentStreamer::StreamerStatus::OK)
+        setStatus(status);
+      else if (itsLast && (itsOffset > *itsLast))
+        setStatus(ContentStreamer::StreamerStatus::EXIT_OK);
+      else if (chunk.empty())
+        continue;
+
+      return chunk;
+    }
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+}  // namespace Download
+}  // namespace Plugin
+}  // namespace SmartMet
@@ -0,0 +1,73 @@
+// ======================================================================
+/*!
+ * \brief SmartMet download service plugin; byte range streaming
+ */
+// ======================================================================
+
+#pragma once
+
+#include "DataStreamer.h"
+#include <optional>
+
+namespace SmartMet
+{
+namespace Plugin
+{
+namespace Download
+{
+// ----------------------------------------------------------------------
+/*!
+ * \brief Byte range of the output to return (HTTP Range request)
+ */
+// ----------------------------------------------------------------------
+
+struct ByteRange
+{
+  std::size_t first = 0;
+  std::optional<std::size_t> last;  // If not set, till the end of the output
+};
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Parse single byte range (bytes=first-[last]) from Range header.
+ *
+ *        Returns empty for multiple, suffix and invalid ranges, which
+ *        are ignored (the whole output is returned)
+ */
+// ----------------------------------------------------------------------
+
+std::optional<ByteRange> parseByteRange(const std::string &rangeHeader);
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Return given byte range of data streamer's output.
+ *
+ *        The range is generated while returning it; the data preceding
+ *        the range is skipped by the streamer if possible, and the rest
+ *        is discarded chunk by chunk
+ */
+// ----------------------------------------------------------------------
+
+class RangeStreamer : public Spine::HTTP::ContentStreamer
+{
+ public:
+  RangeStreamer(const std::shared_ptr<DataStreamer> &streamer, const ByteRange &range);
+  virtual ~RangeStreamer();
+
+  virtual std::string getChunk();
+
+ private:
+  RangeStreamer();
+
+  std::string readChunk();
+
+  std::shared_ptr<DataStreamer> itsStreamer;
+  std::size_t itsFirst;
+  std::optional<std::size_t> itsLast;
+  std::size_t itsOffset = 0;  // Output offset of the next chunk
+  bool itsSkipped = false;    // If set, cheap skipping to range start has been done
+};
+
+}  // namespace Download
+}  // namespace Plugin
+}  // namespace SmartMet
@@ -0,0 +1,326 @@
+// ======================================================================
+/*!
+ * \brief SmartMet download service plugin; request cost estimation
+ *        and admission control
+ */
+// ======================================================================
+
+#include "RequestCost.h"
+#include <macgyver/Exception.h>
+#include <macgyver/StringConversion.h>
+#include <algorithm>
+#include <chrono>
+
+using namespace std;
+
+namespace SmartMet
+{
+namespace Plugin
+{
+namespace Download
+{
+namespace
+{
+// Cpu cost weights per data value
+
+const double passThroughByteWeight = 0.01;  // Source data returned as is; per output byte
+const double extractionWeight = 1;         // Extracting data from native grid
+const double interpolationWeight = 4;      // Interpolating to nonnative grid/projection
+const double datumShiftWeight = 8;         // Transforming coordinates using gdal/proj
+const double simplePackingWeight = 1;      // grib simple (and ieee) packing
+const double complexPackingWeight = 4;     // grib second order, jpeg etc. packing
+const double netcdfWeight = 2;             // Writing and reading back temporary netcdf file
+const double qdWeight = 0.5;               // Writing querydata
+
+const int defaultBitsPerValue = 24;  // Used for output size estimation if not known
+}  // namespace
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Cpu cost weight for given output format and packing
+ */
+// ----------------------------------------------------------------------
+
+double outputCostWeight(OutputFormat outputFormat, const std::string &packing)
+{
+  if (outputFormat == NetCdf)
+    return netcdfWeight;
+
+  if (outputFormat == QD)
+    return qdWeight;
+
+  if (packing.empty() || (packing == "grid_simple") || (packing == "grid_ieee"))
+    return simplePackingWeight;
+
+  return complexPackingWeight;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Estimate request cost
+ */
+// ----------------------------------------------------------------------
+
+RequestCost estimateRequestCost(const ReqParams &reqParams,
+                                std::size_t nParams,
+                                std::size_t nLevels,
+                                std::size_t nTimes,
+                                std::size_t gridSize,
+                                bool interpolated,
+                                const std::optional<std::size_t> &outputSize,
+                                const std::optional<std::size_t> &estimatedOutputSize)
+{
+  try
+  {
+    RequestCost cost;
+    std::size_t nGrids = nParams * nLevels * nTimes;
+
+    cost.numValues = nGrids * gridSize;
+
+    if (outputSize)
+    {
+      // Source data is returned as is
+
+      cost.outputBytes = *outputSize;
+      cost.exactOutputBytes = true;
+      cost.cpu = passThroughByteWeight * cost.outputBytes;
+
+      return cost;
+    }
+
+    double weight = extractionWeight + outputCostWeight(reqParams.outputFormat, reqParams.packing);
+
+    if (reqParams.datumShift != Datum::DatumShift::None)
+      weight += datumShiftWeight;
+    else if (interpolated)
+      weight += interpolationWeight;
+
+    cost.cpu = weight * cost.numValues;
+
+    // Output size
+
+    if (estimatedOutputSize)
+      cost.outputBytes = *estimatedOutputSize;
+    else if ((reqParams.outputFormat == Grib1) || (reqParams.outputFormat == Grib2))
+    {
+      auto bitsPerValue =
+          ((reqParams.bitsPerValue > 0) ? reqParams.bitsPerValue : defaultBitsPerValue);
+      cost.outputBytes = (cost.numValues * bitsPerValue) / 8;
+    }
+    else
+      cost.outputBytes = cost.numValues * sizeof(float);
+
+    // Memory usage; current grid's values and target grid coordinates, and format specific
+    // buffering
+
+    cost.memoryBytes = gridSize * sizeof(float);
+
+    if (interpolated || (reqParams.datumShift != Datum::DatumShift::None))
+      cost.memoryBytes += gridSize * 2 * sizeof(double);
+
+    if ((reqParams.outputFormat == Grib1) || (reqParams.outputFormat == Grib2))
+      // Value array passed to grib_api and the encoded message
+      //
+      cost.memoryBytes += gridSize * sizeof(double) + (nGrids ? (cost.outputBytes / nGrids) : 0);
+    else if (reqParams.outputFormat == NetCdf)
+      // Complete netcdf file is written to temporary (memory mapped) directory
+      //
+      cost.memoryBytes += cost.outputBytes;
+    else
+      // All grids of a parameter are loaded before streaming them
+      //
+      cost.memoryBytes += nLevels * nTimes * gridSize * sizeof(float);
+
+    return cost;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Return cost as json
+ */
+// ----------------------------------------------------------------------
+
+std::string RequestCost::toJson() const
+{
+  try
+  {
+    return string("{\n") + "  \"values\": " + Fmi::to_string(numValues) + ",\n" +
+           "  \"cpu\": " + Fmi::to_string(static_cast<unsigned long>(cpu)) + ",\n" +
+           "  \"memorybytes\": " + Fmi::to_string(memoryBytes) + ",\n" +
+           "  \"outputbytes\": " + Fmi::to_string(outputBytes) + ",\n" +
+           "  \"exactoutputbytes\": " + (exactOutputBytes ? "true" : "false") + "\n" + "}\n";
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Admission ticket holding request's share of the budget
+ */
+// ----------------------------------------------------------------------
+
+AdmissionControl::Ticket::Ticket(AdmissionControl &admissionControl, double cost)
+    : itsAdmissionControl(admissionControl), itsCost(cost)
+{
+}
+
+AdmissionControl::Ticket::~Ticket()
+{
+  itsAdmissionControl.release(itsCost);
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Change the share of the budget
+ */
+// ----------------------------------------------------------------------
+
+bool AdmissionControl::Ticket::setCost(double cost)
+{
+  try
+  {
+    if (!itsAdmissionControl.adjust(itsCost, cost))
+      return false;
+
+    itsCost = cost;
+
+    return true;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Initialize admission control.
+ *
+ *		If default cost is not given, 10% of the budget is used
+ */
+// ----------------------------------------------------------------------
+
+void AdmissionControl::init(double maxConcurrentCost,
+                            double defaultCost,
+                            unsigned int maxQueued,
+                            unsigned int queueTimeout)
+{
+  itsMaxConcurrentCost = maxConcurrentCost;
+  itsDefaultCost = ((defaultCost > 0) ? std::min(defaultCost, maxConcurrentCost)
+                                      : (maxConcurrentCost / 10));
+  itsMaxQueued = maxQueued;
+  itsQueueTimeout = queueTimeout;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Admit request or reject it if the budget does not allow it
+ *        within the queue timeout.
+ *
+ *		The request is queued if the budget does not allow it or other
+ *		requests are already queued
+ */
+// ----------------------------------------------------------------------
+
+bool AdmissionControl::admit(double cost, std::shared_ptr<Ticket> &ticket)
+{
+  try
+  {
+    ticket.reset();
+
+    if (!enabled())
+      return true;
+
+    if (!affordable(cost))
+      return false;
+
+    std::unique_lock<std::mutex> lock(itsMutex);
+
+    auto fits = [this, cost]() { return ((itsActiveCost + cost) <= itsMaxConcurrentCost); };
+
+    if ((!itsQueue.empty()) || (!fits()))
+    {
+      if ((itsQueue.size() >= itsMaxQueued) || (itsQueueTimeout == 0))
+        return false;
+
+      // The address of the local ticket pointer identifies the request in the queue
+
+      auto position = itsQueue.insert(itsQueue.end(), &ticket);
+
+      bool admitted = itsCondition.wait_for(lock, std::chrono::seconds(itsQueueTimeout), [&]() {
+        return ((itsQueue.front() == &ticket) && fits());
+      });
+
+      itsQueue.erase(position);
+
+      // The next queued request may fit too, or it may have been waiting for this one
+
+      itsCondition.notify_all();
+
+      if (!admitted)
+        return false;
+    }
+
+    itsActiveCost += cost;
+
+    ticket = std::make_shared<Ticket>(*this, cost);
+
+    return true;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Change admitted request's share of the budget. Returns false if
+ *		the budget does not allow the increased cost
+ */
+// ----------------------------------------------------------------------
+
+bool AdmissionControl::adjust(double cost, double newCost)
+{
+  {
+    std::lock_guard<std::mutex> lock(itsMutex);
+
+    if ((newCost > cost) && ((itsActiveCost + newCost - cost) > itsMaxConcurrentCost))
+      return false;
+
+    itsActiveCost = (((itsActiveCost + newCost) > cost) ? (itsActiveCost + newCost - cost) : 0);
+  }
+
+  itsCondition.notify_all();
+
+  return true;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Release completed request's share of the budget
+ */
+// ----------------------------------------------------------------------
+
+void AdmissionControl::release(double cost)
+{
+  {
+    std::lock_guard<std::mutex> lock(itsMutex);
+
+    itsActiveCost = ((itsActiveCost > cost) ? (itsActiveCost - cost) : 0);
+  }
+
+  itsCondition.notify_all();
+}
+
+}  // namespace Download
+}  // namespace Plugin
+}  // namespace SmartMet
@@ -0,0 +1,148 @@
+// ======================================================================
+/*!
+ * \brief SmartMet download service plugin; request cost estimation
+ *        and admission control
+ */
+// ======================================================================
+
+#pragma once
+
+#include "Query.h"
+#include <condition_variable>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+
+namespace SmartMet
+{
+namespace Plugin
+{
+namespace Download
+{
+// ----------------------------------------------------------------------
+/*!
+ * \brief Estimated request cost
+ *
+ *        Cpu cost is given in (weighted) data value units; each value
+ *        costs 1 unit when just extracted and encoded, more when it is
+ *        interpolated, transformed or packed using more expensive packing.
+ */
+// ----------------------------------------------------------------------
+
+struct RequestCost
+{
+  unsigned long numValues = 0;  // params x levels x times x gridsize
+  double cpu = 0;               // Weighted number of values
+  std::size_t memoryBytes = 0;  // Estimated peak memory (or tmpfs) usage
+  std::size_t outputBytes = 0;  // Estimated output size
+  bool exactOutputBytes = false;
+
+  std::string toJson() const;
+};
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Estimate request cost
+ *
+ *        If output size is known, the source data is returned as is and
+ *        the cost consists of i/o only
+ */
+// ----------------------------------------------------------------------
+
+RequestCost estimateRequestCost(const ReqParams &reqParams,
+                                std::size_t nParams,
+                                std::size_t nLevels,
+                                std::size_t nTimes,
+                                std::size_t gridSize,
+                                bool interpolated,
+                                const std::optional<std::size_t> &outputSize,
+                                const std::optional<std::size_t> &estimatedOutputSize);
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Cpu cost weight for given output format and packing
+ */
+// ----------------------------------------------------------------------
+
+double outputCostWeight(OutputFormat outputFormat, const std::string &packing);
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Admission control
+ *
+ *        Limits the total estimated cpu cost of concurrently processed
+ *        requests. Requests costing more than the budget are never
+ *        admitted. A request is admitted if the budget allows it;
+ *        otherwise it is queued for max given time for other requests
+ *        to complete and is rejected if the budget does not allow it by
+ *        then or if max number of requests are already queued. Queued
+ *        requests are admitted in arrival order.
+ */
+// ----------------------------------------------------------------------
+
+class AdmissionControl
+{
+ public:
+  // Admitted request's share of the budget; released when destroyed (when data extraction
+  // is finished or the streamer owning it is destroyed)
+
+  class Ticket
+  {
+   public:
+    Ticket(AdmissionControl &admissionControl, double cost);
+    ~Ticket();
+
+    Ticket() = delete;
+    Ticket(const Ticket &other) = delete;
+    Ticket &operator=(const Ticket &other) = delete;
+
+    // Change the share of the budget (when the cost is estimated after admission). Returns
+    // false if the budget does not allow the increased cost
+
+    bool setCost(double cost);
+
+   private:
+    AdmissionControl &itsAdmissionControl;
+    double itsCost;
+  };
+
+  AdmissionControl() = default;
+  AdmissionControl(const AdmissionControl &other) = delete;
+  AdmissionControl &operator=(const AdmissionControl &other) = delete;
+
+  void init(double maxConcurrentCost,
+            double defaultCost,
+            unsigned int maxQueued,
+            unsigned int queueTimeout);
+
+  // Returns false if the request was rejected. Ticket is not set if admission control is disabled
+
+  bool admit(double cost, std::shared_ptr<Ticket> &ticket);
+
+  bool enabled() const { return (itsMaxConcurrentCost > 0); }
+  bool affordable(double cost) const { return ((!enabled()) || (cost <= itsMaxConcurrentCost)); }
+
+  // Cost reserved for requests whose cost can not be estimated before loading data
+
+  double defaultCost() const { return itsDefaultCost; }
+
+ private:
+  bool adjust(double cost, double newCost);
+  void release(double cost);
+
+  double itsMaxConcurrentCost = 0;  // If 0, admission control is disabled
+  double itsDefaultCost = 0;
+  unsigned int itsMaxQueued = 0;     // Max number of queued requests
+  unsigned int itsQueueTimeout = 0;  // Max seconds to wait for the budget to allow the request
+
+  std::mutex itsMutex;
+  std::condition_variable itsCondition;
+  double itsActiveCost = 0;
+  std::list<const void *> itsQueue;  // Queued requests in arrival order
+};
+
+}  // namespace Download
+}  // namespace Plugin
+}  // namespace SmartMet
@@ -0,0 +1,373 @@
+// ======================================================================
+/*!
+ * \brief SmartMet download service plugin; sharing the output of
+ *        identical concurrent requests
+ */
+// ======================================================================
+
+#include "SharedStreamer.h"
+#include <macgyver/Exception.h>
+#include <chrono>
+#include <iostream>
+
+using namespace std;
+
+namespace SmartMet
+{
+namespace Plugin
+{
+namespace Download
+{
+using StreamerStatus = Spine::HTTP::ContentStreamer::StreamerStatus;
+
+SharedStream::SharedStream(std::size_t maxBufferSize) : itsMaxBufferSize(maxBufferSize) {}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Subscribe to the stream.
+ *
+ *		The stream can be joined until the buffer is filled; a subscriber
+ *		joining later would hold back the others since the buffered
+ *		chunks are released only after all subscribers have read them.
+ *		A completed stream can be joined too if the source completed
+ *		successfully and none of the chunks has been released
+ */
+// ----------------------------------------------------------------------
+
+bool SharedStream::subscribe(std::size_t &subscriberId)
+{
+  try
+  {
+    std::lock_guard<std::mutex> lock(itsMutex);
+
+    if (itsFailed || (itsFirstChunk > 0) || (itsDone && (itsStatus != StreamerStatus::EXIT_OK)) ||
+        ((!itsDone) && (itsBufferSize >= itsMaxBufferSize)))
+      return false;
+
+    subscriberId = itsNextSubscriberId++;
+    itsPositions[subscriberId] = 0;
+
+    return true;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Unsubscribe from the stream
+ */
+// ----------------------------------------------------------------------
+
+void SharedStream::unsubscribe(std::size_t subscriberId)
+{
+  {
+    std::lock_guard<std::mutex> lock(itsMutex);
+
+    itsPositions.erase(subscriberId);
+
+    if ((subscriberId == 0) && (!itsSourceSet))
+      itsFailed = true;
+
+    releaseChunks();
+  }
+
+  itsCondition.notify_all();
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Set the source streamer
+ */
+// ----------------------------------------------------------------------
+
+void SharedStream::setSource(const std::shared_ptr<DataStreamer> &streamer,
+                             const std::string &fileName)
+{
+  try
+  {
+    {
+      std::lock_guard<std::mutex> lock(itsMutex);
+
+      itsSource = streamer;
+      itsOutputSize = streamer->getOutputSize();
+      itsEstimatedOutputSize = streamer->getEstimatedOutputSize();
+      itsFileName = fileName;
+      itsSourceSet = true;
+    }
+
+    itsCondition.notify_all();
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Wait for the source streamer to be set.
+ *
+ *		Waits at most given number of seconds, since creating the source
+ *		streamer may take long (e.g. loading data) or the creator may be
+ *		waiting for admission
+ */
+// ----------------------------------------------------------------------
+
+bool SharedStream::waitForSource(unsigned int timeout)
+{
+  try
+  {
+    std::unique_lock<std::mutex> lock(itsMutex);
+
+    itsCondition.wait_for(lock, std::chrono::seconds(timeout), [this]() {
+      return (itsSourceSet || itsFailed);
+    });
+
+    return itsSourceSet;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Release the chunks read by all subscribers when the buffer is full
+ */
+// ----------------------------------------------------------------------
+
+void SharedStream::releaseChunks()
+{
+  std::size_t minPosition = itsFirstChunk + itsChunks.size();
+
+  for (auto const &position : itsPositions)
+    minPosition = min(minPosition, position.second);
+
+  while ((itsBufferSize >= itsMaxBufferSize) && (itsFirstChunk < minPosition))
+  {
+    itsBufferSize -= itsChunks.front().size();
+    itsChunks.pop_front();
+    itsFirstChunk++;
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Get subscriber's next chunk.
+ *
+ *		If the chunk has not been generated yet, it is fetched from the
+ *		source streamer unless another subscriber is already fetching it.
+ *		If the buffer is full, waits for the slower subscribers to read
+ */
+// ----------------------------------------------------------------------
+
+std::string SharedStream::getChunk(std::size_t subscriberId, StreamerStatus &status)
+{
+  try
+  {
+    std::unique_lock<std::mutex> lock(itsMutex);
+
+    status = StreamerStatus::OK;
+
+    while (true)
+    {
+      auto &position = itsPositions.at(subscriberId);
+
+      if (position < (itsFirstChunk + itsChunks.size()))
+      {
+        string chunk = itsChunks[position - itsFirstChunk];
+        position++;
+
+        if (itsDone && (position == (itsFirstChunk + itsChunks.size())))
+          status = itsStatus;
+
+        releaseChunks();
+        itsCondition.notify_all();
+
+        return chunk;
+      }
+
+      if (itsDone)
+      {
+        status = itsStatus;
+        return "";
+      }
+
+      if (itsProducing)
+      {
+        itsCondition.wait(lock);
+        continue;
+      }
+
+      if (itsBufferSize >= itsMaxBufferSize)
+      {
+        // Wait for the slower subscribers to read
+
+        itsCondition.wait(lock);
+        continue;
+      }
+
+      // Get next chunk from the source
+
+      itsProducing = true;
+      lock.unlock();
+
+      string chunk;
+      auto sourceStatus = StreamerStatus::EXIT_ERROR;
+
+      try
+      {
+        chunk = itsSource->getChunk();
+        sourceStatus = itsSource->getStatus();
+      }
+      catch (...)
+      {
+        Fmi::Exception::Trace(BCP, "Shared stream processing exception!").printError();
+      }
+
+      lock.lock();
+      itsProducing = false;
+
+      if (!chunk.empty())
+      {
+        itsBufferSize += chunk.size();
+        itsChunks.push_back(std::move(chunk));
+      }
+
+      if (sourceStatus != StreamerStatus::OK)
+      {
+        // Release the source streamer and its resources
+
+        itsDone = true;
+        itsStatus = sourceStatus;
+        itsSource.reset();
+      }
+
+      itsCondition.notify_all();
+    }
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Shared stream subscriber's output
+ */
+// ----------------------------------------------------------------------
+
+SharedStreamer::SharedStreamer(const std::shared_ptr<SharedStream> &stream,
+                               std::size_t subscriberId)
+    : Spine::HTTP::ContentStreamer(), itsStream(stream), itsSubscriberId(subscriberId)
+{
+}
+
+SharedStreamer::~SharedStreamer()
+{
+  itsStream->unsubscribe(itsSubscriberId);
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Get next chunk of data. Called from SmartMet server code
+ */
+// ----------------------------------------------------------------------
+
+std::string SharedStreamer::getChunk()
+{
+  try
+  {
+    auto status = StreamerStatus::EXIT_ERROR;
+    string chunk;
+
+    try
+    {
+      chunk = itsStream->getChunk(itsSubscriberId, status);
+    }
+    catch (...)
+    {
+      Fmi::Exception exception(BCP, "Request processing exception!", nullptr);
+      std::cerr << exception.getStackTrace();
+    }
+
+    if (status != StreamerStatus::OK)
+      setStatus(status);
+
+    return chunk;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Initialize shared streams
+ */
+// ----------------------------------------------------------------------
+
+void SharedStreams::init(std::size_t maxBufferSize)
+{
+  itsMaxBufferSize = maxBufferSize;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Join identical request's stream or create a new stream for the request.
+ *
+ *		The caller is the creator of the stream if the returned subscriber's
+ *		isCreator() returns true; otherwise it must wait for the source to be
+ *		set before using the stream
+ */
+// ----------------------------------------------------------------------
+
+std::shared_ptr<SharedStreamer> SharedStreams::join(const std::string &requestKey)
+{
+  try
+  {
+    std::lock_guard<std::mutex> lock(itsMutex);
+
+    // Remove completed streams
+
+    for (auto it = itsStreams.begin(); (it != itsStreams.end());)
+    {
+      if (it->second.expired())
+        it = itsStreams.erase(it);
+      else
+        it++;
+    }
+
+    std::size_t subscriberId;
+    auto it = itsStreams.find(requestKey);
+
+    if (it != itsStreams.end())
+    {
+      auto stream = it->second.lock();
+
+      if (stream && stream->subscribe(subscriberId))
+        return std::make_shared<SharedStreamer>(stream, subscriberId);
+    }
+
+    auto stream = std::make_shared<SharedStream>(itsMaxBufferSize);
+
+    stream->subscribe(subscriberId);
+    itsStreams[requestKey] = stream;
+
+    return std::make_shared<SharedStreamer>(stream, subscriberId);
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+}  // namespace Download
+}  // namespace Plugin
+}  // namespace SmartMet
@@ -0,0 +1,150 @@
+// ======================================================================
+/*!
+ * \brief SmartMet download service plugin; sharing the output of
+ *        identical concurrent requests
+ */
+// ======================================================================
+
+#pragma once
+
+#include "DataStreamer.h"
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <optional>
+
+namespace SmartMet
+{
+namespace Plugin
+{
+namespace Download
+{
+// ----------------------------------------------------------------------
+/*!
+ * \brief Data streamer output shared by identical concurrent requests.
+ *
+ *        The subscriber needing a chunk not generated yet gets it from the
+ *        source streamer and the chunk is buffered for other subscribers.
+ *        Chunks read by all subscribers are released when the buffer is
+ *        full; the stream can be joined until the buffer is filled. When
+ *        the buffer is full, the faster subscribers wait for the slowest
+ *        ones; subscribers are never dropped.
+ *
+ *        The first subscriber creates the source streamer; the stream fails
+ *        if it unsubscribes before setting the source.
+ */
+// ----------------------------------------------------------------------
+
+class SharedStream
+{
+ public:
+  explicit SharedStream(std::size_t maxBufferSize);
+  SharedStream() = delete;
+  SharedStream(const SharedStream &other) = delete;
+  SharedStream &operator=(const SharedStream &other) = delete;
+
+  // Returns false if the stream can not be joined anymore
+
+  bool subscribe(std::size_t &subscriberId);
+  void unsubscribe(std::size_t subscriberId);
+
+  void setSource(const std::shared_ptr<DataStreamer> &streamer, const std::string &fileName);
+
+  // Returns false if the source streamer could not be created or was not set within given
+  // number of seconds
+
+  bool waitForSource(unsigned int timeout);
+
+  std::string getChunk(std::size_t subscriberId,
+                       Spine::HTTP::ContentStreamer::StreamerStatus &status);
+
+  // Source streamer's output size and file name; available when the source is set
+
+  std::optional<std::size_t> getOutputSize() const { return itsOutputSize; }
+  std::optional<std::size_t> getEstimatedOutputSize() const { return itsEstimatedOutputSize; }
+  const std::string &getFileName() const { return itsFileName; }
+
+ private:
+  void releaseChunks();
+
+  std::size_t itsMaxBufferSize;
+
+  std::mutex itsMutex;
+  std::condition_variable itsCondition;
+
+  std::shared_ptr<DataStreamer> itsSource;
+  bool itsSourceSet = false;
+  bool itsFailed = false;     // Set if the source streamer could not be created
+  bool itsProducing = false;  // Set while a subscriber is getting a chunk from the source
+  bool itsDone = false;       // Set when the source has returned all data
+  Spine::HTTP::ContentStreamer::StreamerStatus itsStatus =
+      Spine::HTTP::ContentStreamer::StreamerStatus::OK;
+
+  std::optional<std::size_t> itsOutputSize;
+  std::optional<std::size_t> itsEstimatedOutputSize;
+  std::string itsFileName;
+
+  std::deque<std::string> itsChunks;  // Buffered chunks
+  std::size_t itsFirstChunk = 0;      // Index of the first buffered chunk
+  std::size_t itsBufferSize = 0;      // Total size of the buffered chunks
+
+  std::map<std::size_t, std::size_t> itsPositions;  // Subscriber's next chunk index
+  std::size_t itsNextSubscriberId = 0;
+};
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Shared stream subscriber's output
+ */
+// ----------------------------------------------------------------------
+
+class SharedStreamer : public Spine::HTTP::ContentStreamer
+{
+ public:
+  SharedStreamer(const std::shared_ptr<SharedStream> &stream, std::size_t subscriberId);
+  virtual ~SharedStreamer();
+
+  virtual std::string getChunk();
+
+  bool isCreator() const { return (itsSubscriberId == 0); }
+  const std::shared_ptr<SharedStream> &getStream() const { return itsStream; }
+
+ private:
+  SharedStreamer();
+
+  std::shared_ptr<SharedStream> itsStream;
+  std::size_t itsSubscriberId;
+};
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief In-flight shared streams by normalized request
+ */
+// ----------------------------------------------------------------------
+
+class SharedStreams
+{
+ public:
+  SharedStreams() = default;
+  SharedStreams(const SharedStreams &other) = delete;
+  SharedStreams &operator=(const SharedStreams &other) = delete;
+
+  void init(std::size_t maxBufferSize);
+
+  bool enabled() const { return (itsMaxBufferSize > 0); }
+
+  // Join identical request's stream or create a new stream for the request
+
+  std::shared_ptr<SharedStreamer> join(const std::string &requestKey);
+
+ private:
+  std::size_t itsMaxBufferSize = 0;  // If 0, requests are not shared
+
+  std::mutex itsMutex;
+  std::map<std::string, std::weak_ptr<SharedStream>> itsStreams;
+};
+
+}  // namespace Download
+}  // namespace Plugin
+}  // namespace SmartMet
@@ -8,11 +8,18 @@
 #include "GribStreamer.h"
 #include "NetCdfStreamer.h"
 #include "QueryDataStreamer.h"
+#include <boost/algorithm/string/classification.hpp>
 #include <boost/algorithm/string/replace.hpp>
+#include <boost/algorithm/string/split.hpp>
+#include <boost/algorithm/string/trim.hpp>
 #include <boost/numeric/conversion/cast.hpp>
 #include <macgyver/Exception.h>
 #include <macgyver/StringConversion.h>
 #include <macgyver/TimeParser.h>
+#include <strings.h>
+#include <algorithm>
+#include <set>
+#include <sstream>
 
 using namespace std;
 
@@ -39,39 +46,44 @@ static bool getScaleFactorAndOffset(signed long id,
   try
   {
     bool radonParam = (!paramName.empty());
-    size_t i = 0, j = ptable.size();
+    size_t i = ptable.size(), j = ptable.size();
 
-    for (; i < ptable.size(); ++i)
+    if (!radonParam)
     {
-      if (radonParam)
+      const auto &indexes = ptable.getIndexesByParamId((unsigned long) id);
+
+      if (!indexes.empty())
       {
-        if (paramName == ptable[i].itsRadonName)
+        *scale = ptable[indexes.front()].itsConversionScale;
+        *offset = ptable[indexes.front()].itsConversionBase;
+
+        return true;
+      }
+    }
+    else
+    {
+      for (auto idx : ptable.getIndexesByRadonName(paramName))
+      {
+        if (outputFormat == NetCdf)
         {
-          if (outputFormat == NetCdf)
-            break;
+          i = idx;
+          break;
+        }
 
-          if (((outputFormat == Grib1) && ptable[i].itsGrib1Param) ||
-              ((outputFormat == Grib2) && ptable[i].itsGrib2Param))
-          {
-            auto const &confProducer = ptable[i].itsRadonProducer;
+        if (((outputFormat == Grib1) && ptable[idx].itsGrib1Param) ||
+            ((outputFormat == Grib2) && ptable[idx].itsGrib2Param))
+        {
+          auto const &confProducer = ptable[idx].itsRadonProducer;
 
-            if (producerName == confProducer)
-              break;
-            else if ((j == ptable.size()) && confProducer.empty())
-              j = i;
+          if (producerName == confProducer)
+          {
+            i = idx;
+            break;
           }
+          else if ((j == ptable.size()) && confProducer.empty())
+            j = idx;
         }
-
-        continue;
       }
-
-      if (id != ptable[i].itsWantedParam.GetIdent())
-        continue;
-
-      *scale = ptable[i].itsConversionScale;
-      *offset = ptable[i].itsConversionBase;
-
-      return true;
     }
 
     // No unit conversion for radon parameters
@@ -256,6 +268,8 @@ std::shared_ptr<DataStreamer> createStreamer(const Spine::HTTP::Request &req,
                                             const Engine::Querydata::Engine &qEngine,
                                             const Engine::Grid::Engine *gridEngine,
                                             const Engine::Geonames::Engine *geoEngine,
+                                            CoordinateCache &coordinateCache,
+                                            ExtractionPool &extractionPool,
                                             ReqParams &reqParams,
                                             const Producer &producer,
                                             Query &query,
@@ -316,6 +330,8 @@ std::shared_ptr<DataStreamer> createStreamer(const Spine::HTTP::Request &req,
     // Set engines
 
     ds->setEngines(&qEngine, gridEngine, geoEngine);
+    ds->setCoordinateCache(&coordinateCache);
+    ds->setExtractionPool(&extractionPool);
 
     // Get Q object for the producer/origintime
 
@@ -365,6 +381,18 @@ std::shared_ptr<DataStreamer> createStreamer(const Spine::HTTP::Request &req,
       // For grid data levels are set after checking data availability
 
       ds->setLevels();
+
+      // If querydata is requested as is, return the source file without extracting the data
+
+      if (ds->isNativeQueryDataRequest())
+      {
+        std::dynamic_pointer_cast<QDStreamer>(ds)->setPassThrough(q->path().string());
+
+        fileName = getDownloadFileName(
+            reqParams.producer, originTime, startTime, endTime, "", reqParams.outputFormat);
+
+        return ds;
+      }
     }
 
     // In order to set response status check if (any) data is available for the requested
@@ -385,6 +413,12 @@ std::shared_ptr<DataStreamer> createStreamer(const Spine::HTTP::Request &req,
         throw Fmi::Exception(BCP, "createStreamer: No data available");
     }
 
+    // Return grid content messages as is if no transformations are needed
+
+    if ((reqParams.dataSource == GridContent) &&
+        ((reqParams.outputFormat == Grib1) || (reqParams.outputFormat == Grib2)))
+      std::dynamic_pointer_cast<GribStreamer>(ds)->setGridContentPassThrough(gridEngine);
+
     // Download file name
 
     string projection = boost::algorithm::replace_all_copy(reqParams.projection, " ", "_");
@@ -401,6 +435,460 @@ std::shared_ptr<DataStreamer> createStreamer(const Spine::HTTP::Request &req,
   }
 }
 
+// ----------------------------------------------------------------------
+/*!
+ * \brief Get content server producers of the requested grid parameters.
+ *
+ *		For grid mapping data the producers are taken from the parameter
+ *		mappings of the requested producer. Function parameters are
+ *		computed from the other parameters and are ignored
+ */
+// ----------------------------------------------------------------------
+
+static std::set<std::string> getGridSourceProducers(const ReqParams &reqParams,
+                                                    const Query &query,
+                                                    const Engine::Grid::Engine *gridEngine)
+{
+  try
+  {
+    std::set<std::string> producers;
+
+    for (auto const &param : query.pOptions.parameters())
+    {
+      if (query.isFunctionParameter(param.name()))
+        continue;
+
+      if (reqParams.dataSource == GridContent)
+      {
+        producers.insert(query.getRadonParameter(param.name()).producer);
+        continue;
+      }
+
+      Engine::Grid::ParameterDetails_vec paramDetails;
+      string paramKey = reqParams.producer + ";" + param.name();
+
+      gridEngine->getParameterDetails(reqParams.producer, param.name(), paramDetails);
+
+      // No mappings found if producer name is the parameter key
+
+      auto noMapping = [&paramKey](const auto &paramDetail) {
+        return (strcasecmp(paramDetail.mProducerName.c_str(), paramKey.c_str()) == 0);
+      };
+
+      if (std::all_of(paramDetails.begin(), paramDetails.end(), noMapping))
+        continue;
+
+      gridEngine->mapParameterDetails(paramDetails);
+
+      for (auto const &paramDetail : paramDetails)
+        if (!noMapping(paramDetail))
+          for (auto const &paramMapping : paramDetail.mMappings)
+            producers.insert(paramMapping.mMapping.mProducerName);
+    }
+
+    return producers;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Get version of the requested data.
+ *
+ *		Grid data version consists of the generation ids of the source
+ *		producers for given origintime, or of their latest valid
+ *		generations if origintime is not given; a new or reprocessed
+ *		model run changes the version. The version is unknown if any of
+ *		the producers has no generation
+ */
+// ----------------------------------------------------------------------
+
+DataVersion getDataVersion(const ReqParams &reqParams,
+                           const Query &query,
+                           const Engine::Querydata::Engine &qEngine,
+                           const Engine::Grid::Engine *gridEngine)
+{
+  try
+  {
+    DataVersion dataVersion;
+
+    if (reqParams.dataSource == QueryData)
+    {
+      Engine::Querydata::Q q;
+
+      if (reqParams.originTime.empty() || (reqParams.originTime == "latest") ||
+          (reqParams.originTime == "newest"))
+        q = qEngine.get(reqParams.producer);
+      else if (reqParams.originTime == "oldest")
+        q = qEngine.get(reqParams.producer, Fmi::DateTime(Fmi::DateTime::NEG_INFINITY));
+      else
+        q = qEngine.get(reqParams.producer, Fmi::TimeParser::parse(reqParams.originTime));
+
+      dataVersion.originTime = q->originTime();
+      dataVersion.hash = q->hashValue();
+
+      return dataVersion;
+    }
+
+    if ((!gridEngine) || (!gridEngine->isEnabled()))
+      return dataVersion;
+
+    // Note: origintime is set by Query for grid content data
+
+    string originTimeStr;
+
+    if (!reqParams.originTime.empty())
+    {
+      originTimeStr = Fmi::to_iso_string(Fmi::TimeParser::parse(reqParams.originTime));
+
+      auto pos = originTimeStr.find(",");
+      if (pos != string::npos)
+        originTimeStr = originTimeStr.substr(0, pos);
+    }
+
+    auto producers = getGridSourceProducers(reqParams, query, gridEngine);
+
+    if (producers.empty())
+      return dataVersion;
+
+    auto cS = gridEngine->getContentServer_sptr();
+    Fmi::DateTime originTime;
+    string generations;
+
+    for (auto const &producer : producers)
+    {
+      T::GenerationInfoList generationInfoList;
+
+      generationInfoList.setComparisonMethod(T::GenerationInfo::ComparisonMethod::analysisTime);
+      cS->getGenerationInfoListByProducerName(0, producer, generationInfoList);
+
+      const T::GenerationInfo *generationInfo = nullptr;
+
+      if (!originTimeStr.empty())
+      {
+        generationInfo = generationInfoList.getGenerationInfoByAnalysisTime(originTimeStr);
+
+        if (generationInfo && (!isValidGeneration(generationInfo)))
+          generationInfo = nullptr;
+      }
+      else
+      {
+        // Generations are fetched to ascending analysistime order
+
+        for (auto idx = generationInfoList.getLength(); ((idx > 0) && (!generationInfo)); idx--)
+        {
+          generationInfo = generationInfoList.getGenerationInfoByIndex(idx - 1);
+
+          if (!isValidGeneration(generationInfo))
+            generationInfo = nullptr;
+        }
+      }
+
+      if (!generationInfo)
+        return dataVersion;
+
+      auto analysisTime = Fmi::TimeParser::parse(generationInfo->mAnalysisTime);
+
+      if (originTime.is_not_a_date_time() || (analysisTime > originTime))
+        originTime = analysisTime;
+
+      generations += producer + ":" + Fmi::to_string(generationInfo->mGenerationId) + ",";
+    }
+
+    dataVersion.originTime = originTime;
+    dataVersion.generations = generations;
+
+    return dataVersion;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Estimate request cost before creating the streamer
+ */
+// ----------------------------------------------------------------------
+
+std::optional<RequestCost> estimateQueryCost(const ReqParams &reqParams,
+                                             const Query &query,
+                                             const Engine::Querydata::Engine &qEngine,
+                                             const Fmi::DateTime &startTime,
+                                             const Fmi::DateTime &endTime)
+{
+  try
+  {
+    bool interpolated = ((!reqParams.projection.empty()) || (!reqParams.geometryId.empty()) ||
+                         (!reqParams.gridSize.empty()) || (!reqParams.gridResolution.empty()));
+    std::size_t gridSize = 0, nLevels = 1, nTimes = reqParams.timeSteps;
+
+    if (reqParams.gridSizeXY)
+      gridSize = (*reqParams.gridSizeXY)[0].first * (*reqParams.gridSizeXY)[0].second;
+
+    if (reqParams.dataSource != QueryData)
+    {
+      // Grid data; each parameter has a single level. Available validtimes are not known
+      // before querying the data
+
+      if ((gridSize == 0) || (nTimes == 0))
+        return std::nullopt;
+    }
+    else
+    {
+      Engine::Querydata::Q q;
+
+      if (reqParams.originTime.empty() || (reqParams.originTime == "latest") ||
+          (reqParams.originTime == "newest"))
+        q = qEngine.get(reqParams.producer);
+      else if (reqParams.originTime == "oldest")
+        q = qEngine.get(reqParams.producer, Fmi::DateTime(Fmi::DateTime::NEG_INFINITY));
+      else
+        q = qEngine.get(reqParams.producer, Fmi::TimeParser::parse(reqParams.originTime));
+
+      // Validtimes within the requested time range
+
+      std::size_t nDataTimes = 0;
+
+      for (auto const &validTime : *(q->validTimes()))
+        if ((startTime.is_not_a_date_time() || (validTime >= startTime)) &&
+            (endTime.is_not_a_date_time() || (validTime <= endTime)))
+          nDataTimes++;
+
+      if ((nTimes == 0) || (nTimes > nDataTimes))
+        nTimes = nDataTimes;
+
+      if (query.levels.begin() != query.levels.end())
+        nLevels = query.levels.size();
+      else
+        for (nLevels = 0, q->resetLevel(); q->nextLevel();)
+          nLevels++;
+
+      if (gridSize == 0)
+        gridSize = q->grid().XNumber() * q->grid().YNumber();
+    }
+
+    return estimateRequestCost(reqParams,
+                               query.pOptions.size(),
+                               nLevels,
+                               nTimes,
+                               gridSize,
+                               interpolated,
+                               std::nullopt,
+                               std::nullopt);
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Get key for identifying identical requests for the same data
+ */
+// ----------------------------------------------------------------------
+
+std::string getRequestKey(const ReqParams &reqParams,
+                          const Query &query,
+                          const Fmi::DateTime &startTime,
+                          const Fmi::DateTime &endTime,
+                          const DataVersion &dataVersion)
+{
+  try
+  {
+    // Note: output is not affected by chunk size; dry runs have no key
+
+    string key = "producer=" + reqParams.producer +
+                 "&source=" + Fmi::to_string(int(reqParams.dataSource)) +
+                 "&format=" + Fmi::to_string(int(reqParams.outputFormat)) + "&param=";
+
+    for (auto const &param : query.pOptions.parameters())
+      key += param.name() + ",";
+
+    key += "&levels=";
+
+    for (auto level : query.levels)
+      key += Fmi::to_string(level) + ",";
+
+    key += "&minlevel=" + Fmi::to_string(reqParams.minLevel) +
+           "&maxlevel=" + Fmi::to_string(reqParams.maxLevel);
+
+    // Times relative to current time are resolved; the rest of the time options (timestep,
+    // hours etc.) are identified by their hash value
+
+    key += "&starttime=" +
+           (startTime.is_not_a_date_time() ? string("data") : Fmi::to_iso_string(startTime)) +
+           "&endtime=" +
+           (endTime.is_not_a_date_time() ? string("data") : Fmi::to_iso_string(endTime)) +
+           "&timesteps=" + Fmi::to_string(reqParams.timeSteps) +
+           "&timestep=" + Fmi::to_string(reqParams.timeStep) +
+           "&maxtimesteps=" + Fmi::to_string(reqParams.maxTimeSteps) +
+           "&tz=" + query.timeZone + "&timeoptions=" + Fmi::to_string(query.tOptions.hash_value());
+
+    key += "&projection=" + Fmi::ascii_tolower_copy(reqParams.projection) +
+           "&geometryid=" + reqParams.geometryId + "&bbox=" + reqParams.bbox +
+           "&gridcenter=" + reqParams.gridCenter + "&gridsize=" + reqParams.gridSize +
+           "&gridresolution=" + reqParams.gridResolution + "&gridstep=" + reqParams.gridStep +
+           "&datum=" + Fmi::to_string(int(reqParams.datumShift)) +
+           "&packing=" + reqParams.packing +
+           "&bitspervalue=" + Fmi::to_string(reqParams.bitsPerValue) +
+           "&tablesversion=" + Fmi::to_string(reqParams.grib2TablesVersion) +
+           "&significantbits=" + Fmi::to_string(reqParams.significantBits) +
+           "&gridparamblocksize=" + Fmi::to_string(reqParams.gridParamBlockSize) +
+           "&gridtimeblocksize=" + Fmi::to_string(reqParams.gridTimeBlockSize) +
+           "&test=" + Fmi::to_string(reqParams.test);
+
+    key += "&origintime=";
+
+    if (!dataVersion.originTime.is_not_a_date_time())
+      key += Fmi::to_iso_string(dataVersion.originTime);
+
+    if (dataVersion.hash != 0)
+      key += "&datahash=" + Fmi::to_string(dataVersion.hash);
+
+    if (!dataVersion.generations.empty())
+      key += "&generations=" + dataVersion.generations;
+
+    return key;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Get entity tag for the response to given request key
+ */
+// ----------------------------------------------------------------------
+
+std::string getEntityTag(const std::string &requestKey, const std::string &contentEncoding)
+{
+  ostringstream entityTag;
+  entityTag << "\"" << getDigest(requestKey);
+
+  if (!contentEncoding.empty())
+    entityTag << "-" << contentEncoding;
+
+  entityTag << "\"";
+
+  return entityTag.str();
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Check if the client has an up to date response.
+ *
+ *		If-Modified-Since is ignored if If-None-Match is given (RFC 9110)
+ */
+// ----------------------------------------------------------------------
+
+bool isNotModified(const Spine::HTTP::Request &req,
+                   const std::string &entityTag,
+                   const Fmi::DateTime &lastModified)
+{
+  try
+  {
+    auto ifNoneMatch = req.getHeader("If-None-Match");
+
+    if (ifNoneMatch)
+    {
+      vector<string> entityTags;
+      boost::algorithm::split(entityTags, *ifNoneMatch, boost::algorithm::is_any_of(","));
+
+      for (auto &tag : entityTags)
+      {
+        boost::algorithm::trim(tag);
+
+        // Weak comparison
+
+        if (tag.substr(0, 2) == "W/")
+          tag.erase(0, 2);
+
+        if ((tag == "*") || (tag == entityTag))
+          return true;
+      }
+
+      return false;
+    }
+
+    auto ifModifiedSince = req.getHeader("If-Modified-Since");
+
+    if ((!ifModifiedSince) || lastModified.is_not_a_date_time())
+      return false;
+
+    try
+    {
+      return (lastModified <= Fmi::TimeParser::parse_http(*ifModifiedSince));
+    }
+    catch (...)
+    {
+      // Invalid dates are ignored
+
+      return false;
+    }
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Check if the requested byte range applies to the current output.
+ *
+ *		If If-Range is given, the range applies only if it matches the
+ *		entity tag (strong comparison) or the last modification time;
+ *		otherwise the whole output is returned (RFC 9110)
+ */
+// ----------------------------------------------------------------------
+
+bool isRangeApplicable(const Spine::HTTP::Request &req,
+                       const std::string &entityTag,
+                       const Fmi::DateTime &lastModified)
+{
+  try
+  {
+    auto ifRange = req.getHeader("If-Range");
+
+    if (!ifRange)
+      return true;
+
+    string validator = boost::algorithm::trim_copy(*ifRange);
+
+    if (validator.empty())
+      return false;
+
+    if ((validator.front() == '"') || (validator.substr(0, 2) == "W/"))
+      return ((!entityTag.empty()) && (validator == entityTag));
+
+    if (lastModified.is_not_a_date_time())
+      return false;
+
+    try
+    {
+      return (lastModified == Fmi::TimeParser::parse_http(validator));
+    }
+    catch (...)
+    {
+      // Invalid dates are ignored
+
+      return false;
+    }
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
 }  // namespace Download
 }  // namespace Plugin
 }  // namespace SmartMet
@@ -7,6 +7,7 @@
 #pragma once
 
 #include "Config.h"
+#include "CoordinateCache.h"
 #include "DataStreamer.h"
 #include "Query.h"
 #include "Tools.h"
@@ -73,6 +74,8 @@ std::shared_ptr<DataStreamer> createStreamer(const Spine::HTTP::Request &req,
                                             const Engine::Querydata::Engine &qEngine,
                                             const Engine::Grid::Engine *gridEngine,
                                             const Engine::Geonames::Engine *geoEngine,
+                                            CoordinateCache &coordinateCache,
+                                            ExtractionPool &extractionPool,
                                             ReqParams &reqParams,
                                             const Producer &producer,
                                             Query &query,
@@ -80,6 +83,102 @@ std::shared_ptr<DataStreamer> createStreamer(const Spine::HTTP::Request &req,
                                             const Fmi::DateTime &endTime,
                                             std::string &fileName);
 
+// ----------------------------------------------------------------------
+/*!
+ * \brief Version of the requested data.
+ *
+ *        For querydata the version is identified by the origintime and
+ *        the hash value of the data, for grid data by the origintime and
+ *        the content server generation ids of the source producers. If
+ *        the version can not be determined, the response has no entity
+ *        tag and it is not cached or shared
+ */
+// ----------------------------------------------------------------------
+
+struct DataVersion
+{
+  Fmi::DateTime originTime;  // not_a_date_time if unknown
+  std::size_t hash = 0;      // Data hash value (querydata only)
+  std::string generations;   // Source producers' generation ids (grid data only)
+
+  bool known() const { return (!originTime.is_not_a_date_time()); }
+};
+
+DataVersion getDataVersion(const ReqParams &reqParams,
+                           const Query &query,
+                           const Engine::Querydata::Engine &qEngine,
+                           const Engine::Grid::Engine *gridEngine);
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Estimate request cost before creating the streamer.
+ *
+ *        The estimate is based on the parsed request and the dimensions
+ *        of the querydata without loading any data. Returns empty for
+ *        grid data requests whose size is not known beforehand (no
+ *        gridsize or timesteps given); their cost is estimated by the
+ *        streamer
+ */
+// ----------------------------------------------------------------------
+
+std::optional<RequestCost> estimateQueryCost(const ReqParams &reqParams,
+                                             const Query &query,
+                                             const Engine::Querydata::Engine &qEngine,
+                                             const Fmi::DateTime &startTime,
+                                             const Fmi::DateTime &endTime);
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Get key for identifying identical requests for the same data.
+ *
+ *        The key is built from the parsed request parameters, resolved
+ *        start and end time and the data version, so that differently
+ *        ordered/written requests for the same output have the same key
+ *        and requests relative to current time get a new key when the
+ *        time changes
+ */
+// ----------------------------------------------------------------------
+
+std::string getRequestKey(const ReqParams &reqParams,
+                          const Query &query,
+                          const Fmi::DateTime &startTime,
+                          const Fmi::DateTime &endTime,
+                          const DataVersion &dataVersion);
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Get (strong) entity tag for the response to given request key.
+ *
+ *        The tag is a fixed (FNV-1a) digest of the key to be stable across
+ *        builds and servers. Responses with content encoding (compression)
+ *        have their own entity tags
+ */
+// ----------------------------------------------------------------------
+
+std::string getEntityTag(const std::string &requestKey, const std::string &contentEncoding = "");
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Check if the client has an up to date response (If-None-Match and
+ *        If-Modified-Since request headers)
+ */
+// ----------------------------------------------------------------------
+
+bool isNotModified(const Spine::HTTP::Request &req,
+                   const std::string &entityTag,
+                   const Fmi::DateTime &lastModified);
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Check if the requested byte range applies to the current output
+ *        (If-Range request header)
+ */
+// ----------------------------------------------------------------------
+
+bool isRangeApplicable(const Spine::HTTP::Request &req,
+                       const std::string &entityTag,
+                       const Fmi::DateTime &lastModified);
+
 }  // namespace Download
 }  // namespace Plugin
 }  // namespace SmartMet
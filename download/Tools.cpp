@@ -1,4 +1,7 @@
 #include "Tools.h"
+#include <cstdint>
+#include <iomanip>
+#include <sstream>
 
 using namespace std;
 
@@ -293,6 +296,31 @@ bool isEnsembleForecast(T::ForecastType forecastType)
   return ((forecastType == 3) || (forecastType == 4));
 }
 
+// ----------------------------------------------------------------------
+/*!
+ * \brief Get fixed digest of a string
+ *
+ */
+// ----------------------------------------------------------------------
+
+std::string getDigest(const std::string &str)
+{
+  // 64 bit FNV-1a
+
+  uint64_t digest = 14695981039346656037ULL;
+
+  for (unsigned char c : str)
+  {
+    digest ^= c;
+    digest *= 1099511628211ULL;
+  }
+
+  ostringstream os;
+  os << hex << setw(16) << setfill('0') << digest;
+
+  return os.str();
+}
+
 // ----------------------------------------------------------------------
 /*!
  * \brief Return radon parameter geometry id
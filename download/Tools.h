@@ -126,6 +126,10 @@ T::ForecastNumber getForecastNumber(
 bool isValidGeneration(const T::GenerationInfo *generationInfo);
 bool isEnsembleForecast(T::ForecastType forecastType);
 
+// Fixed (64 bit FNV-1a) digest of a string as hex; unlike std::hash it is stable across builds
+// and can be used for names or tags shared by servers
+std::string getDigest(const std::string &str);
+
 // ----------------------------------------------------------------------
 /*!
  * \brief Return pairs of values from comma separated string
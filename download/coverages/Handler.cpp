@@ -10,6 +10,7 @@
 // ======================================================================
 
 #include "coverages/Handler.h"
+#include "ContentEncoding.h"
 #include "ParamConfig.h"
 #include "Query.h"
 #include "StreamerFactory.h"
@@ -746,6 +747,31 @@ static const Producer &fillReqParams(const Spine::HTTP::Request &req,
       throw Fmi::Exception(BCP, "Invalid packing bitspervalue, must be in range 0-32");
     }
 
+    // Number of significant bits for netcdf bit-rounding
+
+    auto significantBits = Spine::optional_string(req.getParameter("significantbits"), "");
+
+    if (!significantBits.empty())
+    {
+      if (reqParams.outputFormat != NetCdf)
+        throw Fmi::Exception(BCP, "Significant bits can be specified with netcdf format only")
+            .addParameter("significantbits", significantBits);
+
+      try
+      {
+        auto bits = Fmi::stoi(significantBits);
+
+        if ((bits < 1) || (bits > 23))
+          throw Fmi::Exception(BCP, "");
+
+        reqParams.significantBits = bits;
+      }
+      catch (...)
+      {
+        throw Fmi::Exception(BCP, "Invalid significantbits, must be in range 1-23");
+      }
+    }
+
     // GRIB2 tables version
     reqParams.grib2TablesVersion =
         ((reqParams.outputFormat == Grib2)
@@ -774,11 +800,17 @@ static const Producer &fillReqParams(const Spine::HTTP::Request &req,
 // ----------------------------------------------------------------------
 
 void CoveragesHandler::init(Config &config,
+                            AdmissionControl &admissionControl,
+                            CoordinateCache &coordinateCache,
+                            ExtractionPool &extractionPool,
                             Engine::Querydata::Engine *qEngine,
                             Engine::Grid::Engine *gridEngine,
                             Engine::Geonames::Engine *geoEngine)
 {
   itsConfig = &config;
+  itsAdmissionControl = &admissionControl;
+  itsCoordinateCache = &coordinateCache;
+  itsExtractionPool = &extractionPool;
   itsQEngine = qEngine;
   itsGridEngine = gridEngine;
   itsGeoEngine = geoEngine;
@@ -1204,20 +1236,119 @@ void CoveragesHandler::handleCoverage(const Spine::HTTP::Request &theRequest,
     if (!reqParams.endTime.empty())
       endTime = query.tOptions.endTime;
 
+    // The response is identified by the request and data version. If the client has an up
+    // to date response, return 304 without processing the request
+
+    const int expires_seconds = 60;
+    Fmi::DateTime t_now = Fmi::SecondClock::universal_time();
+
+    // NetCDF and querydata output is compressed if accepted by the client
+
+    auto compression = getCompression(theRequest, *itsConfig, producer, reqParams.outputFormat);
+
+    // If the data version can not be determined, the response has no entity tag
+
+    auto dataVersion = getDataVersion(reqParams, query, *itsQEngine, itsGridEngine);
+    string entityTag;
+
+    if (dataVersion.known())
+      entityTag = getEntityTag(getRequestKey(reqParams, query, startTime, endTime, dataVersion),
+                               compression.enabled() ? compression.name() : "");
+
+    auto lastModified = (dataVersion.known() ? dataVersion.originTime : t_now);
+
+    Fmi::DateTime t_expires = t_now + Fmi::Seconds(expires_seconds);
+    std::shared_ptr<Fmi::TimeFormatter> tformat(Fmi::TimeFormatter::create("http"));
+
+    if (dataVersion.known() && isNotModified(theRequest, entityTag, dataVersion.originTime))
+    {
+      theResponse.setStatus(Spine::HTTP::Status::not_modified);
+
+      if (compression.negotiable)
+        theResponse.setHeader("Vary", "Accept-Encoding");
+
+      theResponse.setHeader("Cache-Control",
+                            ("public, max-age=" + Fmi::to_string(expires_seconds)));
+      theResponse.setHeader("Expires", tformat->format(t_expires));
+      theResponse.setHeader("Last-Modified", tformat->format(lastModified));
+      theResponse.setHeader("ETag", entityTag);
+      return;
+    }
+
+    // Estimate request cost before creating the streamer (which loads the first grid); if it can
+    // not be estimated beforehand, it is estimated by the streamer
+    auto cost = estimateQueryCost(reqParams, query, *itsQEngine, startTime, endTime);
+
+    // Admission control; requests costing more than the budget are rejected, otherwise the
+    // request waits in queue for the budget to allow it until the queue timeout expires. If the
+    // cost can not be estimated beforehand, the default cost is reserved while the streamer
+    // estimates it. The ticket is released when data extraction is finished
+    auto rejectRequest = [&](bool tooExpensive) {
+      if (tooExpensive)
+      {
+        theResponse.setStatus(Spine::HTTP::Status::bad_request);
+        theResponse.setHeader("X-Download-Error",
+                              "Request is too expensive, reduce the request size");
+      }
+      else
+      {
+        theResponse.setStatus(Spine::HTTP::Status::service_unavailable);
+        theResponse.setHeader("Retry-After", Fmi::to_string(itsConfig->getAdmissionRetryAfter()));
+        theResponse.setHeader("X-Download-Error", "Server is busy, retry later");
+      }
+    };
+
+    auto admissionCost = (cost ? cost->cpu : itsAdmissionControl->defaultCost());
+    std::shared_ptr<AdmissionControl::Ticket> ticket;
+
+    if (!itsAdmissionControl->affordable(admissionCost))
+    {
+      rejectRequest(true);
+      return;
+    }
+
+    if (!itsAdmissionControl->admit(admissionCost, ticket))
+    {
+      rejectRequest(false);
+      return;
+    }
+
     // Create and initialize the streamer
     string filename;
-    theResponse.setContent(createStreamer(dlReq,
-                                         *itsConfig,
-                                         *itsQEngine,
-                                         itsGridEngine,
-                                         itsGeoEngine,
-                                         reqParams,
-                                         producer,
-                                         query,
-                                         startTime,
-                                         endTime,
-                                         filename));
+    auto streamer = createStreamer(dlReq,
+                                   *itsConfig,
+                                   *itsQEngine,
+                                   itsGridEngine,
+                                   itsGeoEngine,
+                                   *itsCoordinateCache,
+                                   *itsExtractionPool,
+                                   reqParams,
+                                   producer,
+                                   query,
+                                   startTime,
+                                   endTime,
+                                   filename);
+
+    if (!cost)
+    {
+      cost = streamer->estimateCost();
+
+      if (!itsAdmissionControl->affordable(cost->cpu))
+      {
+        rejectRequest(true);
+        return;
+      }
+
+      if (ticket && (!ticket->setCost(cost->cpu)))
+      {
+        rejectRequest(false);
+        return;
+      }
+    }
 
+    streamer->setAdmissionTicket(ticket);
+
+    setCompressedContent(theResponse, streamer, compression, std::nullopt, cost->outputBytes);
     theResponse.setStatus(Spine::HTTP::Status::ok);
 
     // Set appropriate MIME type based on output format
@@ -1227,15 +1358,13 @@ void CoveragesHandler::handleCoverage(const Spine::HTTP::Request &theRequest,
     theResponse.setHeader("Access-Control-Allow-Origin", "*");
 
     // Cache headers
-    const int expires_seconds = 60;
-    Fmi::DateTime t_now = Fmi::SecondClock::universal_time();
-    Fmi::DateTime t_expires = t_now + Fmi::Seconds(expires_seconds);
-    std::shared_ptr<Fmi::TimeFormatter> tformat(Fmi::TimeFormatter::create("http"));
-
     theResponse.setHeader("Cache-Control",
                           ("public, max-age=" + Fmi::to_string(expires_seconds)));
     theResponse.setHeader("Expires", tformat->format(t_expires));
-    theResponse.setHeader("Last-Modified", tformat->format(t_now));
+    theResponse.setHeader("Last-Modified", tformat->format(lastModified));
+
+    if (!entityTag.empty())
+      theResponse.setHeader("ETag", entityTag);
   }
   catch (...)
   {
@@ -12,6 +12,9 @@
 #pragma once
 
 #include "Config.h"
+#include "CoordinateCache.h"
+#include "ExtractionPool.h"
+#include "RequestCost.h"
 #include <engines/geonames/Engine.h>
 #include <engines/grid/Engine.h>
 #include <engines/querydata/Engine.h>
@@ -32,6 +35,9 @@ class CoveragesHandler
   CoveragesHandler &operator=(const CoveragesHandler &other) = delete;
 
   void init(Config &config,
+            AdmissionControl &admissionControl,
+            CoordinateCache &coordinateCache,
+            ExtractionPool &extractionPool,
             Engine::Querydata::Engine *qEngine,
             Engine::Grid::Engine *gridEngine,
             Engine::Geonames::Engine *geoEngine);
@@ -59,6 +65,9 @@ class CoveragesHandler
                       const std::string &collectionId);
 
   Config *itsConfig = nullptr;
+  AdmissionControl *itsAdmissionControl = nullptr;
+  CoordinateCache *itsCoordinateCache = nullptr;
+  ExtractionPool *itsExtractionPool = nullptr;
   Engine::Querydata::Engine *itsQEngine = nullptr;
   Engine::Grid::Engine *itsGridEngine = nullptr;
   Engine::Geonames::Engine *itsGeoEngine = nullptr;
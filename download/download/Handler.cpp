@@ -5,7 +5,9 @@
 // ======================================================================
 
 #include "download/Handler.h"
+#include "ContentEncoding.h"
 #include "Query.h"
+#include "RangeStreamer.h"
 #include "StreamerFactory.h"
 #include <boost/algorithm/string.hpp>
 #include <boost/algorithm/string/replace.hpp>
@@ -15,6 +17,7 @@
 #include <macgyver/Exception.h>
 #include <macgyver/StringConversion.h>
 #include <macgyver/TimeFormatter.h>
+#include <macgyver/TimeParser.h>
 #include <spine/Convenience.h>
 #include <spine/FmiApiKey.h>
 #include <spine/HostInfo.h>
@@ -427,6 +430,31 @@ static const Producer &getRequestParams(const Spine::HTTP::Request &req,
       throw Fmi::Exception(BCP, "Invalid packing bitspervalue, must be in range 0-32");
     }
 
+    // Number of significant bits for netcdf bit-rounding
+
+    auto significantBits = getRequestParam(req, producer, "significantbits", "");
+
+    if (!significantBits.empty())
+    {
+      if (reqParams.outputFormat != NetCdf)
+        throw Fmi::Exception(BCP, "Significant bits can be specified with netcdf format only")
+            .addParameter("significantbits", significantBits);
+
+      try
+      {
+        auto bits = Fmi::stoi(significantBits);
+
+        if ((bits < 1) || (bits > 23))
+          throw Fmi::Exception(BCP, "");
+
+        reqParams.significantBits = bits;
+      }
+      catch (...)
+      {
+        throw Fmi::Exception(BCP, "Invalid significantbits, must be in range 1-23");
+      }
+    }
+
     // Tables version for grib2
 
     reqParams.grib2TablesVersion =
@@ -480,6 +508,121 @@ static const Producer &getRequestParams(const Spine::HTTP::Request &req,
   }
 }
 
+// ----------------------------------------------------------------------
+/*!
+ * \brief Check if the output is deterministic (data origintime is fixed) and
+ *        thus byte ranges of it can be returned for resuming the download
+ */
+// ----------------------------------------------------------------------
+
+static bool isResumable(const ReqParams &reqParams)
+{
+  return ((!reqParams.originTime.empty()) && (reqParams.originTime != "latest") &&
+          (reqParams.originTime != "newest") && (reqParams.originTime != "oldest"));
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Determine start/end times from parsed request parameters
+ */
+// ----------------------------------------------------------------------
+
+static void getRequestTimes(const Spine::HTTP::Request &req,
+                            const Producer &producer,
+                            const ReqParams &reqParams,
+                            const Query &query,
+                            Fmi::DateTime &startTime,
+                            Fmi::DateTime &endTime)
+{
+  try
+  {
+    auto now = getRequestParam(req, producer, "now", "");
+
+    if ((!reqParams.startTime.empty()) || (!now.empty()))
+      startTime = query.tOptions.startTime;
+
+    if (!reqParams.endTime.empty())
+      endTime = query.tOptions.endTime;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Set response caching headers
+ */
+// ----------------------------------------------------------------------
+
+static void setCacheHeaders(Spine::HTTP::Response &theResponse,
+                            const string &entityTag,
+                            const Fmi::DateTime &lastModified,
+                            const Fmi::DateTime &t_now,
+                            int expires_seconds)
+{
+  try
+  {
+    Fmi::DateTime t_expires = t_now + Fmi::Seconds(expires_seconds);
+    std::shared_ptr<Fmi::TimeFormatter> tformat(Fmi::TimeFormatter::create("http"));
+    std::string cachecontrol =
+        "public, max-age=" + boost::lexical_cast<std::string>(expires_seconds);
+    std::string expiration = tformat->format(t_expires);
+    std::string modification =
+        tformat->format(lastModified.is_not_a_date_time() ? t_now : lastModified);
+
+    theResponse.setHeader("Cache-Control", cachecontrol.c_str());
+    theResponse.setHeader("Expires", expiration.c_str());
+    theResponse.setHeader("Last-Modified", modification.c_str());
+
+    if (!entityTag.empty())
+      theResponse.setHeader("ETag", entityTag);
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Set response headers common to all successful responses
+ */
+// ----------------------------------------------------------------------
+
+static void setResponseHeaders(Spine::HTTP::Response &theResponse,
+                               const std::optional<std::size_t> &outputSize,
+                               const std::optional<std::size_t> &estimatedOutputSize,
+                               const string &filename,
+                               const string &entityTag,
+                               const Fmi::DateTime &lastModified,
+                               const Fmi::DateTime &t_now,
+                               int expires_seconds)
+{
+  try
+  {
+    // Set estimated output size (e.g. for showing download progress) if the exact size is
+    // not known
+
+    if ((!outputSize) && estimatedOutputSize)
+      theResponse.setHeader("X-Download-Estimated-Size", Fmi::to_string(*estimatedOutputSize));
+
+    string mime = "application/octet-stream";
+    theResponse.setHeader("Content-type", mime.c_str());
+    theResponse.setHeader("Content-Disposition",
+                          (string("attachement; filename=") + filename).c_str());
+
+    // Defining the response header information
+
+    setCacheHeaders(theResponse, entityTag, lastModified, t_now, expires_seconds);
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
 // ----------------------------------------------------------------------
 /*!
  * \brief Initialize handler
@@ -487,16 +630,292 @@ static const Producer &getRequestParams(const Spine::HTTP::Request &req,
 // ----------------------------------------------------------------------
 
 void DownloadHandler::init(Config &config,
+                           AdmissionControl &admissionControl,
+                           SharedStreams &sharedStreams,
+                           HotProducts &hotProducts,
+                           OutputCache &outputCache,
+                           OriginTimeWatcher &originTimeWatcher,
+                           CoordinateCache &coordinateCache,
+                           ExtractionPool &extractionPool,
+                           MessageIndex &messageIndex,
                            Engine::Querydata::Engine *qEngine,
                            Engine::Grid::Engine *gridEngine,
                            Engine::Geonames::Engine *geoEngine)
 {
   itsConfig = &config;
+  itsAdmissionControl = &admissionControl;
+  itsSharedStreams = &sharedStreams;
+  itsHotProducts = &hotProducts;
+  itsOutputCache = &outputCache;
+  itsOriginTimeWatcher = &originTimeWatcher;
+  itsCoordinateCache = &coordinateCache;
+  itsExtractionPool = &extractionPool;
+  itsMessageIndex = &messageIndex;
   itsQEngine = qEngine;
   itsGridEngine = gridEngine;
   itsGeoEngine = geoEngine;
 }
 
+// ----------------------------------------------------------------------
+/*!
+ * \brief Get pregenerated product's request key for current data
+ */
+// ----------------------------------------------------------------------
+
+std::string DownloadHandler::getProductKey(const Spine::HTTP::Request &theRequest) const
+{
+  try
+  {
+    ReqParams reqParams;
+    const auto &producer =
+        getRequestParams(theRequest, reqParams, *itsConfig, *itsQEngine, itsGridEngine);
+
+    // Note: origintime is set by Query for grid content data
+
+    Query query(theRequest, itsGridEngine, reqParams.originTime, reqParams.test);
+
+    Fmi::DateTime startTime, endTime;
+
+    getRequestTimes(theRequest, producer, reqParams, query, startTime, endTime);
+
+    // Products are not pregenerated if the data version can not be determined
+
+    auto dataVersion = getDataVersion(reqParams, query, *itsQEngine, itsGridEngine);
+
+    if (!dataVersion.known())
+      return "";
+
+    return getRequestKey(reqParams, query, startTime, endTime, dataVersion);
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Create data streamer for pregenerated product.
+ *
+ *		The request key is built from the data version resolved for the
+ *		streamer; querydata origintime is fixed to it. Pregeneration is
+ *		subject to admission control like the requests; if the budget
+ *		does not allow it, nullptr is returned and the product is
+ *		generated later
+ */
+// ----------------------------------------------------------------------
+
+std::shared_ptr<DataStreamer> DownloadHandler::createProductStreamer(
+    const Spine::HTTP::Request &theRequest, std::string &filename, std::string &requestKey) const
+{
+  try
+  {
+    ReqParams reqParams;
+    const auto &producer =
+        getRequestParams(theRequest, reqParams, *itsConfig, *itsQEngine, itsGridEngine);
+
+    auto query = Query(theRequest, itsGridEngine, reqParams.originTime, reqParams.test);
+
+    Fmi::DateTime startTime, endTime;
+
+    getRequestTimes(theRequest, producer, reqParams, query, startTime, endTime);
+
+    requestKey.clear();
+
+    auto dataVersion = getDataVersion(reqParams, query, *itsQEngine, itsGridEngine);
+
+    if (!dataVersion.known())
+      return nullptr;
+
+    if (reqParams.dataSource == QueryData)
+      reqParams.originTime = Fmi::to_iso_string(dataVersion.originTime);
+
+    requestKey = getRequestKey(reqParams, query, startTime, endTime, dataVersion);
+
+    auto cost = estimateQueryCost(reqParams, query, *itsQEngine, startTime, endTime);
+
+    // If the cost can not be estimated beforehand, the default cost is reserved while the
+    // streamer estimates it
+
+    auto admissionCost = (cost ? cost->cpu : itsAdmissionControl->defaultCost());
+    std::shared_ptr<AdmissionControl::Ticket> ticket;
+
+    if (!itsAdmissionControl->admit(admissionCost, ticket))
+      return nullptr;
+
+    auto streamer = createStreamer(theRequest,
+                                   *itsConfig,
+                                   *itsQEngine,
+                                   itsGridEngine,
+                                   itsGeoEngine,
+                                   *itsCoordinateCache,
+                                   *itsExtractionPool,
+                                   reqParams,
+                                   producer,
+                                   query,
+                                   startTime,
+                                   endTime,
+                                   filename);
+
+    if (!cost)
+    {
+      cost = streamer->estimateCost();
+
+      if (ticket && (!ticket->setCost(cost->cpu)))
+        return nullptr;
+    }
+
+    streamer->setAdmissionTicket(ticket);
+
+    return streamer;
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Check if request is fast (small).
+ *
+ *        The request's cost is estimated cheaply from request options and
+ *        querydata dimensions, using upper bounds for the number of levels,
+ *        times and grid size. Grid data requests are classified as fast only
+ *        if gridsize, timesteps and parameter levels are given
+ */
+// ----------------------------------------------------------------------
+
+bool DownloadHandler::queryIsFast(const Spine::HTTP::Request &theRequest) const
+{
+  try
+  {
+    auto maxCost = itsConfig->getMaxFastQueryCost();
+
+    if (maxCost == 0)
+      return false;
+
+    ReqParams reqParams;
+
+    reqParams.format = Spine::optional_string(theRequest.getParameter("format"), "");
+    Fmi::ascii_toupper(reqParams.format);
+
+    if (reqParams.format == "GRIB1")
+      reqParams.outputFormat = Grib1;
+    else if (reqParams.format == "GRIB2")
+      reqParams.outputFormat = Grib2;
+    else if (reqParams.format == "NETCDF")
+      reqParams.outputFormat = NetCdf;
+    else if (reqParams.format == "QD")
+      reqParams.outputFormat = QD;
+    else
+      return false;
+
+    reqParams.packing = Spine::optional_string(theRequest.getParameter("packing"), "");
+    Fmi::ascii_tolower(reqParams.packing);
+
+    // Epsg projections and datum shifts need gdal/proj coordinate transformations
+
+    auto projection =
+        Fmi::ascii_tolower_copy(Spine::optional_string(theRequest.getParameter("projection"), ""));
+    auto datum = Spine::optional_string(theRequest.getParameter("datum"), "");
+    auto gridSizeOpt = Spine::optional_string(theRequest.getParameter("gridsize"), "");
+
+    reqParams.datumShift = ((projection.find("epsg:") == 0) || (!datum.empty()))
+                               ? Datum::DatumShift::Fmi
+                               : Datum::DatumShift::None;
+
+    if (theRequest.getParameter("gridresolution"))
+      return false;
+
+    bool interpolated = ((!projection.empty()) || (!gridSizeOpt.empty()));
+    std::size_t gridSize = 0;
+
+    if (!gridSizeOpt.empty())
+    {
+      auto gridSizeXY = nPairsOfValues<unsigned int>(gridSizeOpt, "gridsize", 1);
+      gridSize = (*gridSizeXY)[0].first * (*gridSizeXY)[0].second;
+    }
+
+    // Parameters
+
+    auto paramOpt = Spine::optional_string(theRequest.getParameter("param"), "");
+
+    if (paramOpt.empty() || (paramOpt.find('{') != string::npos))
+      return false;
+
+    vector<string> params;
+    boost::algorithm::split(params, paramOpt, boost::algorithm::is_any_of(","));
+
+    std::size_t nLevels = 1, nTimes;
+    std::size_t timeSteps = Spine::optional_unsigned_long(theRequest.getParameter("timesteps"), 0);
+    auto source = Spine::optional_string(theRequest.getParameter("source"), "querydata");
+
+    if (source != "querydata")
+    {
+      // Grid data; level must be given in parameter name (level ranges and lists are not
+      // accepted)
+
+      if ((gridSize == 0) || (timeSteps == 0))
+        return false;
+
+      for (auto const &param : params)
+      {
+        vector<string> paramParts;
+        boost::algorithm::split(paramParts, param, boost::algorithm::is_any_of(":"));
+
+        if ((paramParts.size() < 5) || paramParts[4].empty() ||
+            (paramParts[4].find_first_of("-;") != string::npos))
+          return false;
+      }
+
+      nTimes = timeSteps;
+    }
+    else
+    {
+      auto producer = Spine::optional_string(
+          theRequest.getParameter("producer"),
+          Spine::optional_string(theRequest.getParameter("model"),
+                                 itsConfig->defaultProducerName()));
+
+      auto q = itsQEngine->get(producer);
+
+      nTimes = q->validTimes()->size();
+
+      if ((timeSteps > 0) && (timeSteps < nTimes))
+        nTimes = timeSteps;
+
+      auto levels = Spine::optional_string(theRequest.getParameter("levels"), "");
+
+      if (!levels.empty())
+        nLevels = std::count(levels.begin(), levels.end(), ',') + 1;
+      else if (!theRequest.getParameter("level"))
+        for (nLevels = 0, q->resetLevel(); q->nextLevel();)
+          nLevels++;
+
+      if (gridSize == 0)
+        gridSize = q->grid().XNumber() * q->grid().YNumber();
+    }
+
+    auto cost = estimateRequestCost(reqParams,
+                                    params.size(),
+                                    nLevels,
+                                    nTimes,
+                                    gridSize,
+                                    interpolated,
+                                    std::nullopt,
+                                    std::nullopt);
+
+    return (cost.cpu <= maxCost);
+  }
+  catch (...)
+  {
+    // Let the request handler report errors
+
+    return false;
+  }
+}
+
 // ----------------------------------------------------------------------
 /*!
  * \brief Handle a /download request
@@ -522,54 +941,361 @@ void DownloadHandler::requestHandler(Spine::Reactor & /* theReactor */,
       const auto &producer =
           getRequestParams(theRequest, reqParams, *itsConfig, *itsQEngine, itsGridEngine);
 
+      // Note: origintime is set by Query for grid content data; check it beforehand
+
+      bool resumable = isResumable(reqParams);
+
       auto query = Query(theRequest, itsGridEngine, reqParams.originTime, reqParams.test);
 
       // Determine start/end times from parsed request parameters
 
-      auto now = getRequestParam(theRequest, producer, "now", "");
-
       Fmi::DateTime startTime, endTime;
 
-      if ((!reqParams.startTime.empty()) || (!now.empty()))
-        startTime = query.tOptions.startTime;
+      getRequestTimes(theRequest, producer, reqParams, query, startTime, endTime);
+
+      // The response is identified by the request and data version. If the client has an up
+      // to date response, return 304 without processing the request
+
+      bool dryRun = (getRequestUInt(theRequest, producer, "dryrun", 0) > 0);
+      string requestKey, entityTag;
+      Fmi::DateTime lastModified;
+
+      // NetCDF and querydata output is compressed if accepted by the client. Byte ranges are
+      // returned uncompressed
 
-      if (!reqParams.endTime.empty())
-        endTime = query.tOptions.endTime;
+      Compression compression;
+
+      if ((!dryRun) && (!theRequest.getHeader("Range")))
+        compression = getCompression(theRequest, *itsConfig, producer, reqParams.outputFormat);
+
+      // If the data version can not be determined, the response has no entity tag and it is
+      // not cached, shared or resumable
+
+      auto dataVersion =
+          (dryRun ? DataVersion() : getDataVersion(reqParams, query, *itsQEngine, itsGridEngine));
+
+      if (dataVersion.known())
+      {
+        requestKey = getRequestKey(reqParams, query, startTime, endTime, dataVersion);
+        entityTag = getEntityTag(requestKey, compression.enabled() ? compression.name() : "");
+        lastModified = dataVersion.originTime;
+
+        if (isNotModified(theRequest, entityTag, lastModified))
+        {
+          theResponse.setStatus(Spine::HTTP::Status::not_modified);
+
+          if (compression.negotiable)
+            theResponse.setHeader("Vary", "Accept-Encoding");
+
+          setCacheHeaders(theResponse, entityTag, lastModified, t_now, expires_seconds);
+          return;
+        }
+      }
+      else
+        resumable = false;
+
+      // Identical requests can be returned from pregenerated products or output cache, or they
+      // can share the output of concurrent requests. Dry runs and byte range requests are
+      // processed separately
+
+      string key;
+
+      if ((itsHotProducts->enabled() || itsOutputCache->enabled() ||
+           itsSharedStreams->enabled()) &&
+          (!theRequest.getHeader("Range")))
+        key = requestKey;
+
+      if ((!key.empty()) && itsHotProducts->enabled())
+      {
+        auto product = itsHotProducts->find(key);
+
+        if (product)
+        {
+          auto outputSize = setCompressedContent(theResponse,
+                                                 std::make_shared<CachedProductStreamer>(*product),
+                                                 compression,
+                                                 product->size,
+                                                 std::nullopt);
+          theResponse.setStatus(Spine::HTTP::Status::ok);
+
+          if (resumable)
+            theResponse.setHeader("Accept-Ranges", "bytes");
+
+          setResponseHeaders(theResponse,
+                             outputSize,
+                             std::nullopt,
+                             product->fileName,
+                             entityTag,
+                             lastModified,
+                             t_now,
+                             expires_seconds);
+          return;
+        }
+      }
+
+      if ((!key.empty()) && itsOutputCache->enabled())
+      {
+        auto cachedOutput = itsOutputCache->find(key);
+
+        if (cachedOutput)
+        {
+          auto outputSize = setCompressedContent(
+              theResponse, cachedOutput, compression, cachedOutput->getOutputSize(), std::nullopt);
+          theResponse.setStatus(Spine::HTTP::Status::ok);
+
+          if (resumable)
+            theResponse.setHeader("Accept-Ranges", "bytes");
+
+          setResponseHeaders(theResponse,
+                             outputSize,
+                             std::nullopt,
+                             cachedOutput->getFileName(),
+                             entityTag,
+                             lastModified,
+                             t_now,
+                             expires_seconds);
+          return;
+        }
+      }
+
+      std::shared_ptr<SharedStreamer> sharedStreamer;
+
+      if ((!key.empty()) && itsSharedStreams->enabled())
+      {
+        sharedStreamer = itsSharedStreams->join(key);
+
+        if (!sharedStreamer->isCreator())
+        {
+          const auto &stream = sharedStreamer->getStream();
+
+          if (stream->waitForSource(itsConfig->getSharedStreamSourceTimeout()))
+          {
+            auto estimatedOutputSize = stream->getEstimatedOutputSize();
+            auto outputSize = setCompressedContent(theResponse,
+                                                   sharedStreamer,
+                                                   compression,
+                                                   stream->getOutputSize(),
+                                                   estimatedOutputSize);
+            theResponse.setStatus(Spine::HTTP::Status::ok);
+
+            if (resumable)
+              theResponse.setHeader("Accept-Ranges", "bytes");
+
+            if (compression.enabled())
+              estimatedOutputSize.reset();
+
+            setResponseHeaders(theResponse,
+                               outputSize,
+                               estimatedOutputSize,
+                               stream->getFileName(),
+                               entityTag,
+                               lastModified,
+                               t_now,
+                               expires_seconds);
+            return;
+          }
+
+          // Processing the identical request failed or its streamer was not created in time;
+          // process this request separately
+
+          sharedStreamer.reset();
+        }
+      }
+
+      // Estimate request cost before creating the streamer (which loads the first grid). If
+      // the cost can not be estimated beforehand, it is estimated by the streamer
+
+      auto cost = estimateQueryCost(reqParams, query, *itsQEngine, startTime, endTime);
+
+      // If dryrun is requested, return estimated request cost instead of the data
+
+      auto returnCost = [&]() {
+        theResponse.setContent(cost->toJson());
+        theResponse.setStatus(Spine::HTTP::Status::ok);
+        theResponse.setHeader("Content-Type", "application/json");
+      };
+
+      if (dryRun && cost)
+      {
+        returnCost();
+        return;
+      }
+
+      // Admission control; requests costing more than the budget are rejected, otherwise the
+      // request waits in queue for the budget to allow it until the queue timeout expires. If
+      // the cost can not be estimated beforehand, the default cost is reserved while the
+      // streamer estimates it. The ticket is released when data extraction is finished
+
+      auto rejectRequest = [&](bool tooExpensive) {
+        if (tooExpensive)
+        {
+          theResponse.setStatus(Spine::HTTP::Status::bad_request);
+          theResponse.setHeader("X-Download-Error",
+                                "Request is too expensive, reduce the request size");
+        }
+        else
+        {
+          theResponse.setStatus(Spine::HTTP::Status::service_unavailable);
+          theResponse.setHeader("Retry-After",
+                                Fmi::to_string(itsConfig->getAdmissionRetryAfter()));
+          theResponse.setHeader("X-Download-Error", "Server is busy, retry later");
+        }
+      };
+
+      auto admissionCost = (cost ? cost->cpu : itsAdmissionControl->defaultCost());
+      std::shared_ptr<AdmissionControl::Ticket> ticket;
+
+      if (!itsAdmissionControl->affordable(admissionCost))
+      {
+        rejectRequest(true);
+        return;
+      }
+
+      if (!itsAdmissionControl->admit(admissionCost, ticket))
+      {
+        rejectRequest(false);
+        return;
+      }
 
       // Create and initialize the streamer
 
       string filename;
-      theResponse.setContent(createStreamer(theRequest,
-                                           *itsConfig,
-                                           *itsQEngine,
-                                           itsGridEngine,
-                                           itsGeoEngine,
-                                           reqParams,
-                                           producer,
-                                           query,
-                                           startTime,
-                                           endTime,
-                                           filename));
+      auto streamer = createStreamer(theRequest,
+                                     *itsConfig,
+                                     *itsQEngine,
+                                     itsGridEngine,
+                                     itsGeoEngine,
+                                     *itsCoordinateCache,
+                                     *itsExtractionPool,
+                                     reqParams,
+                                     producer,
+                                     query,
+                                     startTime,
+                                     endTime,
+                                     filename);
+
+      if (!cost)
+      {
+        cost = streamer->estimateCost();
 
-      theResponse.setStatus(Spine::HTTP::Status::ok);
+        if (dryRun)
+        {
+          returnCost();
+          return;
+        }
 
-      string mime = "application/octet-stream";
-      theResponse.setHeader("Content-type", mime.c_str());
-      theResponse.setHeader("Content-Disposition",
-                            (string("attachement; filename=") + filename).c_str());
+        if (!itsAdmissionControl->affordable(cost->cpu))
+        {
+          rejectRequest(true);
+          return;
+        }
+
+        if (ticket && (!ticket->setCost(cost->cpu)))
+        {
+          rejectRequest(false);
+          return;
+        }
+      }
+
+      streamer->setAdmissionTicket(ticket);
+
+      // Deterministic grib output's message sizes are indexed for resuming the download
+
+      if (resumable)
+        streamer->setMessageIndex(*itsMessageIndex, requestKey);
+
+      // Return the requested byte range if the output is deterministic and the client's copy
+      // of it (If-Range) is current
+
+      auto outputSize = streamer->getOutputSize();
+      std::optional<ByteRange> range;
+
+      if (resumable)
+      {
+        auto rangeHeader = theRequest.getHeader("Range");
+
+        if (rangeHeader && isRangeApplicable(theRequest, entityTag, lastModified))
+          range = parseByteRange(*rangeHeader);
+
+        if (range && outputSize)
+        {
+          if (range->first >= *outputSize)
+          {
+            theResponse.setStatus(Spine::HTTP::Status::requested_range_not_satisfiable);
+            theResponse.setHeader("Content-Range", "bytes */" + Fmi::to_string(*outputSize));
+            return;
+          }
+
+          if ((!range->last) || (*range->last >= *outputSize))
+            range->last = *outputSize - 1;
+        }
+        else if (range)
+        {
+          // The output size is not known beforehand. The range is returned if it starts
+          // within the leading part of the output which can be skipped without generating
+          // the data (e.g. grib messages whose sizes are indexed by an earlier request for
+          // the same output), truncated to that part; the client requests the rest
+          // separately. Otherwise the whole output is returned
+
+          auto skippableSize = streamer->getSkippableSize();
+
+          if (range->first >= skippableSize)
+            range.reset();
+          else if ((!range->last) || (*range->last >= skippableSize))
+            range->last = skippableSize - 1;
+        }
+
+        theResponse.setHeader("Accept-Ranges", "bytes");
+      }
+
+      if (range)
+      {
+        auto rangeStreamer = std::make_shared<RangeStreamer>(streamer, *range);
+
+        theResponse.setContent(rangeStreamer);
+        theResponse.setStatus(Spine::HTTP::Status::partial_content);
+        theResponse.setHeader("Content-Range",
+                              "bytes " + Fmi::to_string(range->first) + "-" +
+                                  Fmi::to_string(*range->last) + "/" +
+                                  (outputSize ? Fmi::to_string(*outputSize) : string("*")));
+        theResponse.setHeader("Content-Length", Fmi::to_string(*range->last - range->first + 1));
+      }
+      else
+      {
+        std::shared_ptr<Spine::HTTP::ContentStreamer> content = streamer;
+
+        if (sharedStreamer)
+        {
+          // Identical concurrent requests get the output from the shared stream
+
+          sharedStreamer->getStream()->setSource(streamer, filename);
+          content = sharedStreamer;
+        }
+
+        // Store the output into the cache while returning it. Output of unknown size is
+        // abandoned if it turns out to be too large
 
-      // Defining the response header information
+        if ((!key.empty()) && itsOutputCache->enabled() &&
+            ((!outputSize) || itsOutputCache->cacheable(*outputSize)))
+          content = itsOutputCache->store(key, filename, content);
 
-      Fmi::DateTime t_expires = t_now + Fmi::Seconds(expires_seconds);
-      std::shared_ptr<Fmi::TimeFormatter> tformat(Fmi::TimeFormatter::create("http"));
-      std::string cachecontrol =
-          "public, max-age=" + boost::lexical_cast<std::string>(expires_seconds);
-      std::string expiration = tformat->format(t_expires);
-      std::string modification = tformat->format(t_now);
+        // Compression is applied to the returned content only; the shared stream and the
+        // cache contain uncompressed output
 
-      theResponse.setHeader("Cache-Control", cachecontrol.c_str());
-      theResponse.setHeader("Expires", expiration.c_str());
-      theResponse.setHeader("Last-Modified", modification.c_str());
+        outputSize =
+            setCompressedContent(theResponse, content, compression, outputSize, cost->outputBytes);
+
+        theResponse.setStatus(Spine::HTTP::Status::ok);
+      }
+
+      setResponseHeaders(theResponse,
+                         outputSize,
+                         (compression.enabled() ? std::nullopt : streamer->getEstimatedOutputSize()),
+                         filename,
+                         entityTag,
+                         lastModified,
+                         t_now,
+                         expires_seconds);
     }
     catch (...)
     {
@@ -613,6 +1339,103 @@ void DownloadHandler::requestHandler(Spine::Reactor & /* theReactor */,
   }
 }
 
+// ----------------------------------------------------------------------
+/*!
+ * \brief Handle a /download/origintime request.
+ *
+ *		Waits (at most given timeout seconds) until origintime later than
+ *		given origintime is available for the producer, and returns the
+ *		latest origintime. If origintime is not given, waits for the next
+ *		origintime
+ */
+// ----------------------------------------------------------------------
+
+void DownloadHandler::originTimeRequestHandler(Spine::Reactor & /* theReactor */,
+                                               const Spine::HTTP::Request &theRequest,
+                                               Spine::HTTP::Response &theResponse)
+{
+  try
+  {
+    try
+    {
+      static Producer dummyProducer;
+
+      auto source = getRequestParam(theRequest, dummyProducer, "source", "querydata");
+      bool gridData = ((source == "grid") || (source == "gridcontent"));
+
+      if ((!gridData) && (source != "querydata"))
+        throw Fmi::Exception(BCP,
+                             "Unknown source '" + source + "', 'querydata' or 'grid' expected");
+
+      auto producer = getRequestParam(theRequest, dummyProducer, "producer", "");
+
+      if (producer.empty())
+        producer = getRequestParam(theRequest, dummyProducer, "model", "");
+
+      if (producer.empty())
+      {
+        if (gridData)
+          throw Fmi::Exception(BCP, "producer option is required with grid data");
+
+        producer = itsConfig->defaultProducerName();
+      }
+
+      Fmi::DateTime originTime;
+      auto originTimeStr = getRequestParam(theRequest, dummyProducer, "origintime", "");
+
+      if (!originTimeStr.empty())
+        originTime = Fmi::TimeParser::parse(originTimeStr);
+
+      auto timeout = getRequestUInt(theRequest,
+                                    dummyProducer,
+                                    "timeout",
+                                    itsConfig->getOriginTimeWaitMaxTimeout());
+      timeout = std::min(timeout, (unsigned long)itsConfig->getOriginTimeWaitMaxTimeout());
+
+      auto updated =
+          itsOriginTimeWatcher->waitForOriginTime(producer, gridData, originTime, timeout);
+
+      if (!updated)
+      {
+        // Too many requests waiting; each of them holds a server thread
+
+        theResponse.setStatus(Spine::HTTP::Status::service_unavailable);
+        theResponse.setHeader("Retry-After",
+                              Fmi::to_string(itsConfig->getOriginTimeWaitCheckInterval()));
+        theResponse.setHeader("X-Download-Error", "Too many waiting requests, retry later");
+        return;
+      }
+
+      string content = "{\"producer\":\"" + producer + "\",\"origintime\":\"" +
+                       Fmi::to_iso_string(originTime) + "\",\"updated\":" +
+                       (*updated ? "true" : "false") + "}";
+
+      theResponse.setContent(content);
+      theResponse.setStatus(Spine::HTTP::Status::ok);
+      theResponse.setHeader("Content-Type", "application/json");
+      theResponse.setHeader("Cache-Control", "no-cache");
+    }
+    catch (...)
+    {
+      Fmi::Exception exception(BCP, "Request processing exception!", nullptr);
+      exception.addParameter("URI", theRequest.getURI());
+      exception.addParameter("ClientIP", theRequest.getClientIP());
+      exception.printError();
+
+      theResponse.setStatus(Spine::HTTP::Status::bad_request);
+
+      std::string msg = exception.what();
+      boost::algorithm::replace_all(msg, "\n", " ");
+      msg = msg.substr(0, 300);
+      theResponse.setHeader("X-Download-Error", msg.c_str());
+    }
+  }
+  catch (...)
+  {
+    throw Fmi::Exception::Trace(BCP, "Operation failed!");
+  }
+}
+
 }  // namespace Download
 }  // namespace Plugin
 }  // namespace SmartMet
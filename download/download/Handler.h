@@ -10,7 +10,15 @@
 #pragma once
 
 #include "Config.h"
+#include "CoordinateCache.h"
 #include "DataStreamer.h"
+#include "ExtractionPool.h"
+#include "HotProducts.h"
+#include "MessageIndex.h"
+#include "OriginTimeWatcher.h"
+#include "OutputCache.h"
+#include "RequestCost.h"
+#include "SharedStreamer.h"
 #include <engines/geonames/Engine.h>
 #include <engines/grid/Engine.h>
 #include <engines/querydata/Engine.h>
@@ -31,6 +39,14 @@ class DownloadHandler
   DownloadHandler &operator=(const DownloadHandler &other) = delete;
 
   void init(Config &config,
+            AdmissionControl &admissionControl,
+            SharedStreams &sharedStreams,
+            HotProducts &hotProducts,
+            OutputCache &outputCache,
+            OriginTimeWatcher &originTimeWatcher,
+            CoordinateCache &coordinateCache,
+            ExtractionPool &extractionPool,
+            MessageIndex &messageIndex,
             Engine::Querydata::Engine *qEngine,
             Engine::Grid::Engine *gridEngine,
             Engine::Geonames::Engine *geoEngine);
@@ -39,8 +55,33 @@ class DownloadHandler
                       const Spine::HTTP::Request &theRequest,
                       Spine::HTTP::Response &theResponse);
 
+  // Waiting for new origintime of a producer (/download/origintime)
+
+  void originTimeRequestHandler(Spine::Reactor &theReactor,
+                                const Spine::HTTP::Request &theRequest,
+                                Spine::HTTP::Response &theResponse);
+
+  bool queryIsFast(const Spine::HTTP::Request &theRequest) const;
+
+  // Pregenerated product's request key for current data, and data streamer for the product
+  // with the request key of the data used by the streamer. Returns nullptr if the product can
+  // not be generated now
+
+  std::string getProductKey(const Spine::HTTP::Request &theRequest) const;
+  std::shared_ptr<DataStreamer> createProductStreamer(const Spine::HTTP::Request &theRequest,
+                                                      std::string &filename,
+                                                      std::string &requestKey) const;
+
  private:
   Config *itsConfig = nullptr;
+  AdmissionControl *itsAdmissionControl = nullptr;
+  SharedStreams *itsSharedStreams = nullptr;
+  HotProducts *itsHotProducts = nullptr;
+  OutputCache *itsOutputCache = nullptr;
+  OriginTimeWatcher *itsOriginTimeWatcher = nullptr;
+  CoordinateCache *itsCoordinateCache = nullptr;
+  ExtractionPool *itsExtractionPool = nullptr;
+  MessageIndex *itsMessageIndex = nullptr;
   Engine::Querydata::Engine *itsQEngine = nullptr;
   Engine::Grid::Engine *itsGridEngine = nullptr;
   Engine::Geonames::Engine *itsGeoEngine = nullptr;
@@ -37,6 +37,8 @@ BuildRequires: smartmet-engine-geonames-devel >= 26.4.13
 BuildRequires: smartmet-engine-grid-devel >= 26.4.24
 BuildRequires: netcdf-cxx4-devel
 BuildRequires: bzip2-devel
+BuildRequires: libzstd-devel
+BuildRequires: zlib-devel
 BuildRequires: jasper-devel
 Requires: gdal312-libs
 Requires: eccodes <= 2.31.1
@@ -56,6 +58,8 @@ Requires: %{smartmet_boost}-iostreams
 Requires: %{smartmet_boost}-system
 Requires: %{smartmet_boost}-thread
 Requires: netcdf-cxx4
+Requires: libzstd
+Requires: zlib
 Provides: %{SPECNAME}
 Obsoletes: smartmet-brainstorm-dlsplugin < 16.11.1
 Obsoletes: smartmet-brainstorm-dlsplugin-debuginfo < 16.11.1
@@ -0,0 +1,455 @@
+// ======================================================================
+/*!
+ * \brief Response status, header and content tests
+ *
+ *        Usage: ResponseTest reactorconfig casedir
+ *
+ *        Each file in the case directory contains a request in the same
+ *        format as the files in input/, an empty line and the expected
+ *        response, one check per line:
+ *
+ *        status <code>               response status
+ *        header <name> <pattern>     header value matches the (glob) pattern
+ *        noheader <name>             header is not set
+ *        body empty                  content is empty
+ *        body full                   content equals the output of the request
+ *                                    without conditional, range and encoding
+ *                                    headers
+ *        body range                  content equals the requested byte range
+ *                                    of the full output
+ *        body gzip|zstd              decoded content equals the full output
+ *        body same <dir>             content equals <dir>/<case>; if the file
+ *                                    does not exist, the content is stored in
+ *                                    it for comparison by a later run (e.g.
+ *                                    with another configuration)
+ *
+ *        Lines starting with '#' are comments.
+ */
+// ======================================================================
+
+#include <spine/HTTP.h>
+#include <spine/HandlerView.h>
+#include <spine/Options.h>
+#include <spine/Reactor.h>
+#include <zstd.h>
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fnmatch.h>
+#include <fstream>
+#include <iostream>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <strings.h>
+#include <thread>
+#include <vector>
+#include <zlib.h>
+
+using namespace SmartMet;
+
+namespace
+{
+// Request headers removed to get the full output
+
+const std::vector<std::string> conditionalHeaders{
+    "Range", "If-Range", "If-None-Match", "If-Modified-Since", "Accept-Encoding"};
+
+struct Result
+{
+  int status = 0;
+  Spine::HTTP::Response response;
+  std::string content;
+};
+
+std::string readFile(const std::filesystem::path &path)
+{
+  std::ifstream in(path, std::ios::binary);
+  std::ostringstream content;
+  content << in.rdbuf();
+
+  return content.str();
+}
+
+void writeFile(const std::filesystem::path &path, const std::string &content)
+{
+  std::filesystem::create_directories(path.parent_path());
+
+  std::ofstream out(path, std::ios::binary);
+  out << content;
+}
+
+// Split case file into request lines and checks
+
+void parseCase(const std::string &text,
+               std::vector<std::string> &requestLines,
+               std::vector<std::string> &checks)
+{
+  std::istringstream in(text);
+  std::string line;
+  bool inRequest = true;
+
+  while (std::getline(in, line))
+  {
+    if (!line.empty() && (line.back() == '\r'))
+      line.pop_back();
+
+    if (inRequest)
+    {
+      if (line.empty())
+        inRequest = false;
+      else
+        requestLines.push_back(line);
+    }
+    else if (!line.empty() && (line[0] != '#'))
+      checks.push_back(line);
+  }
+}
+
+std::string headerName(const std::string &line)
+{
+  return line.substr(0, line.find(':'));
+}
+
+std::string requestHeader(const std::vector<std::string> &requestLines, const std::string &name)
+{
+  for (std::size_t i = 1; i < requestLines.size(); i++)
+    if (strcasecmp(headerName(requestLines[i]).c_str(), name.c_str()) == 0)
+    {
+      auto value = requestLines[i].substr(requestLines[i].find(':') + 1);
+      value.erase(0, value.find_first_not_of(' '));
+
+      return value;
+    }
+
+  return "";
+}
+
+std::vector<std::string> fullRequest(const std::vector<std::string> &requestLines)
+{
+  std::vector<std::string> lines;
+
+  for (const auto &line : requestLines)
+    if ((lines.empty()) ||
+        (std::none_of(conditionalHeaders.begin(),
+                      conditionalHeaders.end(),
+                      [&line](const std::string &name)
+                      { return (strcasecmp(headerName(line).c_str(), name.c_str()) == 0); })))
+      lines.push_back(line);
+
+  return lines;
+}
+
+Result execute(Spine::Reactor &reactor, const std::vector<std::string> &requestLines)
+{
+  // Input files use a tab after the method and plain newlines
+
+  std::string message;
+
+  for (const auto &line : requestLines)
+    message += line + "\r\n";
+
+  message += "\r\n";
+
+  auto pos = message.find('\t');
+
+  if (pos != std::string::npos)
+    message[pos] = ' ';
+
+  auto parsed = Spine::HTTP::parseRequest(message);
+
+  if (parsed.first != Spine::HTTP::ParsingStatus::COMPLETE)
+    throw std::runtime_error("Failed to parse request '" + requestLines.front() + "'");
+
+  auto view = reactor.getHandlerView(*parsed.second);
+
+  if (!view)
+    throw std::runtime_error("No handler for request '" + requestLines.front() + "'");
+
+  Result result;
+
+  Spine::HandlerView &handler = *view;
+  handler.handle(reactor, *parsed.second, result.response);
+
+  // Streamed content is read completely by getContent()
+
+  result.status = static_cast<int>(result.response.getStatus());
+  result.content = result.response.getContent();
+
+  return result;
+}
+
+std::string gunzip(const std::string &content)
+{
+  z_stream stream{};
+
+  if (inflateInit2(&stream, 16 + MAX_WBITS) != Z_OK)
+    throw std::runtime_error("inflateInit2 failed");
+
+  std::string output;
+  char buffer[65536];
+  int ret = Z_OK;
+
+  stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(content.data()));
+  stream.avail_in = content.size();
+
+  while (ret != Z_STREAM_END)
+  {
+    stream.next_out = reinterpret_cast<Bytef *>(buffer);
+    stream.avail_out = sizeof(buffer);
+
+    ret = inflate(&stream, Z_NO_FLUSH);
+
+    if ((ret != Z_OK) && (ret != Z_STREAM_END))
+    {
+      inflateEnd(&stream);
+      throw std::runtime_error("Invalid gzip content");
+    }
+
+    output.append(buffer, sizeof(buffer) - stream.avail_out);
+  }
+
+  inflateEnd(&stream);
+
+  return output;
+}
+
+std::string unzstd(const std::string &content)
+{
+  auto *stream = ZSTD_createDStream();
+  ZSTD_initDStream(stream);
+
+  std::string output;
+  std::vector<char> buffer(ZSTD_DStreamOutSize());
+  ZSTD_inBuffer in{content.data(), content.size(), 0};
+  ZSTD_outBuffer out{};
+  std::size_t ret = 0;
+
+  do
+  {
+    out = ZSTD_outBuffer{buffer.data(), buffer.size(), 0};
+    ret = ZSTD_decompressStream(stream, &out, &in);
+
+    if (ZSTD_isError(ret))
+    {
+      ZSTD_freeDStream(stream);
+      throw std::runtime_error(std::string("Invalid zstd content: ") + ZSTD_getErrorName(ret));
+    }
+
+    output.append(buffer.data(), out.pos);
+  } while ((in.pos < in.size) || (out.pos == out.size));
+
+  if (ret != 0)
+  {
+    ZSTD_freeDStream(stream);
+    throw std::runtime_error("Truncated zstd content");
+  }
+
+  ZSTD_freeDStream(stream);
+
+  return output;
+}
+
+// Requested byte range (bytes=first-last, bytes=first- or bytes=-suffix) of the full output
+
+std::string byteRange(const std::string &range, const std::string &full)
+{
+  auto spec = range.substr(range.find('=') + 1);
+  auto dash = spec.find('-');
+  std::size_t first, last;
+
+  if (dash == 0)
+  {
+    auto suffix = std::min<std::size_t>(std::stoul(spec.substr(1)), full.size());
+    first = full.size() - suffix;
+    last = full.size() - 1;
+  }
+  else
+  {
+    first = std::stoul(spec.substr(0, dash));
+    last = ((dash + 1 < spec.size()) ? std::stoul(spec.substr(dash + 1)) : (full.size() - 1));
+    last = std::min(last, full.size() - 1);
+  }
+
+  if (first > last)
+    return "";
+
+  return full.substr(first, last - first + 1);
+}
+
+std::string compareContent(const std::string &content, const std::string &expected)
+{
+  if (content == expected)
+    return "";
+
+  auto mismatch = std::mismatch(content.begin(),
+                                content.begin() + std::min(content.size(), expected.size()),
+                                expected.begin());
+
+  return "content differs at offset " + std::to_string(mismatch.first - content.begin()) +
+         " (size " + std::to_string(content.size()) + ", expected " +
+         std::to_string(expected.size()) + ")";
+}
+
+// Returns error messages of failed checks
+
+std::vector<std::string> runCase(Spine::Reactor &reactor, const std::filesystem::path &caseFile)
+{
+  std::vector<std::string> requestLines, checks, errors;
+
+  parseCase(readFile(caseFile), requestLines, checks);
+
+  if (requestLines.empty())
+    return {"no request"};
+
+  auto result = execute(reactor, requestLines);
+  std::optional<std::string> full;
+
+  auto fullContent = [&]() -> const std::string &
+  {
+    if (!full)
+      full = execute(reactor, fullRequest(requestLines)).content;
+
+    return *full;
+  };
+
+  for (const auto &check : checks)
+  {
+    std::istringstream in(check);
+    std::string keyword, name, pattern, error;
+
+    in >> keyword >> name;
+    std::getline(in >> std::ws, pattern);
+
+    if (keyword == "status")
+    {
+      if (std::to_string(result.status) != name)
+        error = "status " + std::to_string(result.status);
+    }
+    else if (keyword == "header")
+    {
+      auto value = result.response.getHeader(name);
+
+      if (!value)
+        error = "header not set";
+      else if (fnmatch(pattern.c_str(), value->c_str(), 0) != 0)
+        error = "header value '" + *value + "'";
+    }
+    else if (keyword == "noheader")
+    {
+      auto value = result.response.getHeader(name);
+
+      if (value)
+        error = "header value '" + *value + "'";
+    }
+    else if ((keyword == "body") && (name == "empty"))
+    {
+      if (!result.content.empty())
+        error = "content size " + std::to_string(result.content.size());
+    }
+    else if ((keyword == "body") && (name == "full"))
+      error = compareContent(result.content, fullContent());
+    else if ((keyword == "body") && (name == "range"))
+      error = compareContent(result.content,
+                             byteRange(requestHeader(requestLines, "Range"), fullContent()));
+    else if ((keyword == "body") && (name == "gzip"))
+      error = compareContent(gunzip(result.content), fullContent());
+    else if ((keyword == "body") && (name == "zstd"))
+      error = compareContent(unzstd(result.content), fullContent());
+    else if ((keyword == "body") && (name == "same"))
+    {
+      auto path = std::filesystem::path(pattern) / caseFile.filename();
+
+      if (std::filesystem::exists(path))
+        error = compareContent(result.content, readFile(path));
+      else
+        writeFile(path, result.content);
+    }
+    else
+      error = "unknown check";
+
+    if (!error.empty())
+      errors.push_back(check + ": " + error);
+  }
+
+  return errors;
+}
+
+}  // namespace
+
+int main(int argc, char *argv[])
+{
+  try
+  {
+    if (argc != 3)
+    {
+      std::cerr << "Usage: " << argv[0] << " reactorconfig casedir" << std::endl;
+      return 1;
+    }
+
+    Spine::Options options;
+    options.quiet = true;
+    options.defaultlogging = false;
+    options.configfile = argv[1];
+    options.parseConfig();
+
+    Spine::Reactor reactor(options);
+    reactor.init();
+
+    // Wait for the plugin to register its handlers
+
+    auto handlers = reactor.getURIMap();
+
+    while (handlers.find("/download") == handlers.end())
+    {
+      std::this_thread::sleep_for(std::chrono::seconds(1));
+      handlers = reactor.getURIMap();
+    }
+
+    std::vector<std::filesystem::path> cases;
+
+    for (const auto &entry : std::filesystem::directory_iterator(argv[2]))
+      if (entry.is_regular_file())
+        cases.push_back(entry.path());
+
+    std::sort(cases.begin(), cases.end());
+
+    int failures = 0;
+
+    for (const auto &caseFile : cases)
+    {
+      std::vector<std::string> errors;
+
+      try
+      {
+        errors = runCase(reactor, caseFile);
+      }
+      catch (const std::exception &e)
+      {
+        errors.push_back(e.what());
+      }
+
+      std::cout << caseFile.filename().string() << " "
+                << std::string(std::max<int>(2, 70 - caseFile.filename().string().size()), '.')
+                << (errors.empty() ? " OK" : " FAILED") << std::endl;
+
+      for (const auto &error : errors)
+        std::cout << "\t" << error << std::endl;
+
+      if (!errors.empty())
+        failures++;
+    }
+
+    std::cout << std::endl
+              << cases.size() << " tests, " << failures << " failures" << std::endl;
+
+    reactor.shutdown();
+
+    return (failures > 0 ? 1 : 0);
+  }
+  catch (const std::exception &e)
+  {
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
+}